@@ -0,0 +1,442 @@
+/**
+ * Measures the cost of single calls of the intersection, shading, vector and color kernels.
+ *
+ * Usage: MicroBenchmark [repeats]
+ *
+ * Every kernel runs over a large set of randomized inputs generated from a fixed seed, the set is walked
+ * repeats times and the fastest walk is reported, in cycles (time stamp counter) and nanoseconds per call.
+ * Where no cycle counter is available only the nanoseconds are reported.
+ * The kernels built on TrianglePack and SpherePool run once per SIMD level supported by the CPU.
+ * The camera rays of the demo scene are timed per ray, traced one by one and by packets.
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include"project.h"
+
+#if defined(_MSC_VER)
+#include<intrin.h>
+#define HAS_CYCLE_COUNTER 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h>
+#define HAS_CYCLE_COUNTER 1
+#else
+#define HAS_CYCLE_COUNTER 0
+#endif
+
+/** Number of inputs of each kernel, large enough not to fit in the L1 and L2 caches. */
+#define MICRO_INPUTS (1 << 16)
+/** Number of sphere models. */
+#define MICRO_SPHERES 1024
+#define MICRO_REPEATS 10
+#define MICRO_SEED 2024
+/** Camera rays of the demo scene are traced over a square image of this side, by packets or one by one. */
+#define MICRO_IMAGE 256
+#define MICRO_PACKETS (MICRO_IMAGE * MICRO_IMAGE / PACKET_SIZE)
+
+static Ray rays[MICRO_INPUTS];
+static Triangle triangles[MICRO_INPUTS];
+static TrianglePack *pack;
+static Model *spheres[MICRO_SPHERES];
+static SpherePool *spherePool;
+static Model *pear;
+static Ray pearRays[MICRO_INPUTS];
+static Scene *scene;
+static RayPacket packets[MICRO_PACKETS];
+static Hit shadowHits[MICRO_INPUTS];
+static Vector shadowLights[MICRO_INPUTS];
+static int numShadowHits;
+static Vector vectorsA[MICRO_INPUTS], vectorsB[MICRO_INPUTS];
+static float scalars[MICRO_INPUTS];
+static Color colorsA[MICRO_INPUTS], colorsB[MICRO_INPUTS];
+static uint32_t packed[MICRO_INPUTS];
+
+/** Results are accumulated here, so that the compiler cannot drop the calls. */
+static volatile float sink;
+
+typedef struct{
+	const char *name;
+	/** Runs the kernel once on every input and returns the number of calls. */
+	int (*run)();
+	/** True if the kernel depends on the SIMD level. */
+	bool packed;
+}Kernel;
+
+static uint64_t ReadCycles(){
+#if HAS_CYCLE_COUNTER
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static float RandomRange(Sampler *sampler, float min, float max){
+	return min + (max - min) * Sampler_next1D(sampler);
+}
+
+static Point RandomPoint(Sampler *sampler, float extent){
+	return Point_new(RandomRange(sampler, -extent, extent), RandomRange(sampler, -extent, extent), RandomRange(sampler, -extent, extent));
+}
+
+/**
+ * Ray starting on a box of the given extent around the center, aimed at a random point of the target area.
+ */
+static Ray RandomRay(Sampler *sampler, const Point *center, float extent, float target){
+	Point offset = RandomPoint(sampler, extent);
+	Point origin = Point_new(center->x + offset.x, center->y + offset.y, center->z + offset.z);
+	offset = RandomPoint(sampler, target);
+	Point aim = Point_new(center->x + offset.x, center->y + offset.y, center->z + offset.z);
+	return Line_init(origin, Vector_normalize(Vector_fromPoints(&origin, &aim)));
+}
+
+/**
+ * Direction of the camera ray through the point (x, y) of the image, like the renderer computes it.
+ */
+static Vector CameraDirection(float x, float y){
+	Camera *camera = scene->camera;
+	float viewport = 2 * tan(camera->fov / 2);
+	Vector direction = Vector_sum(camera->front, Vector_scale(camera->right, (x / MICRO_IMAGE - 0.5) * viewport));
+	return Vector_sum(direction, Vector_scale(camera->up, (0.5 - y / MICRO_IMAGE) * viewport));
+}
+
+/**
+ * Packets of the camera rays of 4x2 pixel blocks, in scanline order of the blocks.
+ */
+static void CreatePackets(){
+	int blocksPerRow = MICRO_IMAGE / PACKET_WIDTH;
+	for(int p = 0; p < MICRO_PACKETS; p++){
+		int left = (p % blocksPerRow) * PACKET_WIDTH;
+		int top = (p / blocksPerRow) * PACKET_HEIGHT;
+		Vector directions[PACKET_SIZE];
+		for(int i = 0; i < PACKET_SIZE; i++){
+			directions[i] = CameraDirection(left + i % PACKET_WIDTH + 0.5f, top + i / PACKET_WIDTH + 0.5f);
+		}
+		Vector corners[4] = {CameraDirection(left, top), CameraDirection(left + PACKET_WIDTH, top),
+			CameraDirection(left + PACKET_WIDTH, top + PACKET_HEIGHT), CameraDirection(left, top + PACKET_HEIGHT)};
+		RayPacket_init(&packets[p], *scene->camera->position, directions, corners);
+	}
+}
+
+static void CreateInputs(){
+	Sampler sampler;
+	Sampler_init(&sampler, 0, 0, MICRO_SEED);
+	Point origin = Point_new(0, 0, 0);
+	pack = TrianglePack_new(MICRO_INPUTS);
+	if(pack == NULL) exit(1);
+
+	for(int i = 0; i < MICRO_INPUTS; i++){
+		rays[i] = RandomRay(&sampler, &origin, 10, 1);
+		Point center = RandomPoint(&sampler, 1);
+		Point vertices[3];
+		for(int k = 0; k < 3; k++){
+			Point offset = RandomPoint(&sampler, 0.5);
+			vertices[k] = Point_new(center.x + offset.x, center.y + offset.y, center.z + offset.z);
+		}
+		triangles[i] = Triangle_new(vertices[0], vertices[1], vertices[2], 0);
+		TrianglePack_set(pack, i, &triangles[i]);
+
+		vectorsA[i] = Vector_init(RandomRange(&sampler, -1, 1), RandomRange(&sampler, -1, 1), RandomRange(&sampler, -1, 1));
+		vectorsB[i] = Vector_init(RandomRange(&sampler, -1, 1), RandomRange(&sampler, -1, 1), RandomRange(&sampler, -1, 1));
+		scalars[i] = RandomRange(&sampler, 0, 1);
+		colorsA[i] = Color_fromRGB(Sampler_next1D(&sampler), Sampler_next1D(&sampler), Sampler_next1D(&sampler));
+		colorsB[i] = Color_fromRGB(Sampler_next1D(&sampler), Sampler_next1D(&sampler), Sampler_next1D(&sampler));
+		packed[i] = Sampler_nextUInt(&sampler) & 0xFFFFFF;
+	}
+
+	Material material = Material_new(COLOR_WHITE, 0.05, COLOR_BLACK, 0, 0);
+	for(int i = 0; i < MICRO_SPHERES; i++){
+		Point center = RandomPoint(&sampler, 1);
+		spheres[i] = Model_createSphere(Point_init(center.x, center.y, center.z), RandomRange(&sampler, 0.1, 0.5), material);
+	}
+	spherePool = SpherePool_new(MICRO_SPHERES);
+	if(spherePool == NULL) exit(1);
+	for(int i = 0; i < MICRO_SPHERES; i++) SpherePool_set(spherePool, i, spheres[i]);
+
+	pear = Model_fromOBJ("models/pear.obj");
+	if(pear == NULL) exit(1);
+	for(int i = 0; i < MICRO_INPUTS; i++){
+		pearRays[i] = RandomRay(&sampler, pear->center, 4 * pear->boundingRadius, pear->boundingRadius);
+	}
+
+	// shaded points of the demo scene, as seen by random camera rays
+	scene = CreateScene(0, NULL);
+	CreatePackets();
+	Light *light = scene->lightSource;
+	numShadowHits = 0;
+	for(int i = 0; i < 4 * MICRO_INPUTS && numShadowHits < MICRO_INPUTS; i++){
+		Vector direction = Vector_init(RandomRange(&sampler, -1, 1), RandomRange(&sampler, -0.6, 0.6), -1);
+		Ray ray = Line_init(*scene->camera->position, Vector_normalize(direction));
+		Hit hit = Scene_intersection(scene, &ray, INFINITY);
+		if(hit.model == NULL || hit.model->type == LIGHT) continue;
+		if(Vector_dot(hit.normal, ray.direction) > 0) hit.normal = Vector_scale(hit.normal, -1);
+		hit.normal = Vector_normalize(hit.normal);
+		shadowHits[numShadowHits] = hit;
+		shadowLights[numShadowHits] = Vector_normalize(Vector_fromPoints(&hit.point, light->position));
+		numShadowHits++;
+	}
+}
+
+static int RunTriangleIntersect(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++){
+		float t;
+		if(Triangle_intersect(&triangles[i], &rays[i], &t)) sum += t;
+	}
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+/**
+ * Tests leaves of TRIANGLE_PACK_WIDTH triangles, one call per leaf.
+ */
+static int RunPackIntersect(){
+	float sum = 0;
+	int calls = MICRO_INPUTS / TRIANGLE_PACK_WIDTH;
+	for(int i = 0; i < calls; i++){
+		float t = INFINITY;
+		if(TrianglePack_intersect(pack, i * TRIANGLE_PACK_WIDTH, TRIANGLE_PACK_WIDTH, &rays[i], &t) >= 0) sum += t;
+	}
+	sink = sum;
+	return calls;
+}
+
+static int RunPackOccluded(){
+	int sum = 0;
+	int calls = MICRO_INPUTS / TRIANGLE_PACK_WIDTH;
+	for(int i = 0; i < calls; i++){
+		sum += TrianglePack_occluded(pack, i * TRIANGLE_PACK_WIDTH, TRIANGLE_PACK_WIDTH, &rays[i], 0, INFINITY);
+	}
+	sink = sum;
+	return calls;
+}
+
+static int RunSphereIntersection(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++){
+		Hit hit = Sphere_intersection(spheres[i & (MICRO_SPHERES - 1)], &rays[i], INFINITY);
+		if(hit.model != NULL) sum += hit.distance;
+	}
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+/**
+ * Tests groups of SPHERE_POOL_WIDTH spheres, one call per group.
+ */
+static int RunPoolIntersect(){
+	float sum = 0;
+	int calls = MICRO_INPUTS / SPHERE_POOL_WIDTH;
+	for(int i = 0; i < calls; i++){
+		float t = INFINITY;
+		int first = (i * SPHERE_POOL_WIDTH) & (MICRO_SPHERES - 1);
+		if(SpherePool_intersect(spherePool, first, SPHERE_POOL_WIDTH, &rays[i], &t) >= 0) sum += t;
+	}
+	sink = sum;
+	return calls;
+}
+
+static int RunPoolOccluded(){
+	int sum = 0;
+	int calls = MICRO_INPUTS / SPHERE_POOL_WIDTH;
+	for(int i = 0; i < calls; i++){
+		int first = (i * SPHERE_POOL_WIDTH) & (MICRO_SPHERES - 1);
+		sum += SpherePool_occluded(spherePool, first, SPHERE_POOL_WIDTH, &rays[i], 0, INFINITY, NULL);
+	}
+	sink = sum;
+	return calls;
+}
+
+static int RunModelIntersection(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++){
+		Hit hit = Model_intersection(pear, &pearRays[i], INFINITY);
+		if(hit.model != NULL) sum += hit.distance;
+	}
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunShadowFactor(){
+	RayCounters counters = {0, 0, 0};
+	float sum = 0;
+	for(int i = 0; i < numShadowHits; i++){
+		Sampler sampler;
+		Sampler_init(&sampler, i, 0, 0);
+		sum += CalculateShadowFactor(scene, shadowHits[i], shadowLights[i], &sampler, &counters);
+	}
+	sink = sum;
+	return numShadowHits;
+}
+
+static int RunScenePrimary(){
+	float sum = 0;
+	for(int p = 0; p < MICRO_PACKETS; p++){
+		for(int i = 0; i < PACKET_SIZE; i++){
+			Hit hit = Scene_intersection(scene, &packets[p].rays[i], INFINITY);
+			if(hit.model != NULL) sum += hit.distance;
+		}
+	}
+	sink = sum;
+	return MICRO_PACKETS * PACKET_SIZE;
+}
+
+static int RunScenePacket(){
+	float sum = 0;
+	uint32_t all = (1u << PACKET_SIZE) - 1;
+	for(int p = 0; p < MICRO_PACKETS; p++){
+		Hit hits[PACKET_SIZE];
+		Scene_intersectPacket(scene, &packets[p], all, hits);
+		for(int i = 0; i < PACKET_SIZE; i++){
+			if(hits[i].model != NULL) sum += hits[i].distance;
+		}
+	}
+	sink = sum;
+	return MICRO_PACKETS * PACKET_SIZE;
+}
+
+static int RunVectorSum(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Vector_sum(vectorsA[i], vectorsB[i]).x;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunVectorScale(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Vector_scale(vectorsA[i], scalars[i]).y;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunVectorDot(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Vector_dot(vectorsA[i], vectorsB[i]);
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunVectorCrossProduct(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Vector_crossProduct(vectorsA[i], vectorsB[i]).z;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunVectorNormalize(){
+	float sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Vector_normalize(vectorsA[i]).x;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunColorNew(){
+	uint32_t sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Color_new(packed[i]).color;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunColorExtract(){
+	uint32_t sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Color_extract(colorsA[i]);
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunColorAdd(){
+	uint32_t sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Color_add(colorsA[i], colorsB[i]).color;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunColorScale(){
+	uint32_t sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Color_scale(colorsA[i], scalars[i]).color;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunColorMultiply(){
+	uint32_t sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Color_multiply(colorsA[i], colorsB[i]).color;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static int RunColorBlend(){
+	uint32_t sum = 0;
+	for(int i = 0; i < MICRO_INPUTS; i++) sum += Color_blend(colorsA[i], colorsB[i], scalars[i]).color;
+	sink = sum;
+	return MICRO_INPUTS;
+}
+
+static const Kernel kernels[] = {
+	{"Triangle_intersect", RunTriangleIntersect, false},
+	{"TrianglePack_intersect", RunPackIntersect, true},
+	{"TrianglePack_occluded", RunPackOccluded, true},
+	{"Sphere_intersection", RunSphereIntersection, false},
+	{"SpherePool_intersect", RunPoolIntersect, true},
+	{"SpherePool_occluded", RunPoolOccluded, true},
+	{"Model_intersection", RunModelIntersection, true},
+	{"CalculateShadowFactor", RunShadowFactor, true},
+	{"Scene_intersection (camera)", RunScenePrimary, true},
+	{"Scene_intersectPacket (camera)", RunScenePacket, true},
+	{"Vector_sum", RunVectorSum, false},
+	{"Vector_scale", RunVectorScale, false},
+	{"Vector_dot", RunVectorDot, false},
+	{"Vector_crossProduct", RunVectorCrossProduct, false},
+	{"Vector_normalize", RunVectorNormalize, false},
+	{"Color_new", RunColorNew, false},
+	{"Color_extract", RunColorExtract, false},
+	{"Color_add", RunColorAdd, false},
+	{"Color_scale", RunColorScale, false},
+	{"Color_multiply", RunColorMultiply, false},
+	{"Color_blend", RunColorBlend, false},
+};
+
+static void RunKernel(const Kernel *kernel, const char *name, int repeats){
+	double bestCycles = INFINITY;
+	double bestTime = INFINITY;
+	int calls = 0;
+	// the first walk only warms up the caches
+	kernel->run();
+	for(int r = 0; r < repeats; r++){
+		double start = GetTimeMs();
+		uint64_t startCycles = ReadCycles();
+		calls = kernel->run();
+		uint64_t cycles = ReadCycles() - startCycles;
+		double elapsed = GetTimeMs() - start;
+		if(cycles < bestCycles) bestCycles = cycles;
+		if(elapsed < bestTime) bestTime = elapsed;
+	}
+
+	if(HAS_CYCLE_COUNTER) printf("%-40s %10d %14.1f %12.2f\n", name, calls, bestCycles / calls, bestTime * 1e6 / calls);
+	else printf("%-40s %10d %14s %12.2f\n", name, calls, "n/a", bestTime * 1e6 / calls);
+}
+
+int main(int argc, char **argv){
+	int repeats = argc > 1 ? atoi(argv[1]) : MICRO_REPEATS;
+	if(repeats < 1) repeats = 1;
+
+	CreateInputs();
+	SimdLevel selected = Simd_level();
+	printf("SIMD level selected: %s\n", Simd_levelName(selected));
+	printf("%-40s %10s %14s %12s\n", "kernel", "calls", "cycles/call", "ns/call");
+	int numKernels = sizeof(kernels) / sizeof(kernels[0]);
+	for(int i = 0; i < numKernels; i++){
+		if(!kernels[i].packed){
+			RunKernel(&kernels[i], kernels[i].name, repeats);
+			continue;
+		}
+		for(int level = 0; level < SIMD_NUM_LEVELS; level++){
+			if(!Simd_supported(level)) continue;
+			char name[64];
+			snprintf(name, sizeof(name), "%s [%s]", kernels[i].name, Simd_levelName(level));
+			Simd_setLevel(level);
+			RunKernel(&kernels[i], name, repeats);
+		}
+		Simd_setLevel(selected);
+	}
+	return 0;
+}
@@ -0,0 +1,220 @@
+/**
+ * Renders a fixed set of scenes at fixed resolutions and seeds and reports the results as JSON,
+ * so that the numbers of two builds can be compared.
+ *
+ * Usage: BenchmarkSuite [output.json] [workers] [frames]
+ *
+ * For each scene the wall time, the primary, shadow and reflection rays per second and the fraction of
+ * the wall time each worker spent rendering are reported. The JSON goes to stdout if no file is given.
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include"project.h"
+
+#define SUITE_WIDTH 640
+#define SUITE_HEIGHT 360
+#define SUITE_ANTI_ALIASING 2
+#define SUITE_FRAMES 3
+/** Seeds the placement of the procedural scenes, changing it changes the numbers of every run. */
+#define SUITE_SEED 2024
+
+typedef struct{
+	const char *name;
+	Scene *(*create)();
+}SuiteScene;
+
+static float RandomRange(Sampler *sampler, float min, float max){
+	return min + (max - min) * Sampler_next1D(sampler);
+}
+
+/**
+ * Creates a scene with a floor and a light, seen from a camera looking towards -z and down by pitch radians.
+ */
+static Scene *CreateBaseScene(Point *cameraPosition, float pitch, Model *floor, Light *light){
+	float fov = 90 * M_PI / 180;
+	// the camera requires exactly perpendicular front and up directions
+	Vector front = Vector_init(0, -sinf(pitch), -cosf(pitch));
+	Vector up = Vector_init(0, cosf(pitch), -sinf(pitch));
+	Camera *camera = Camera_new(cameraPosition, front, up, fov);
+	Scene *scene = Scene_init(camera);
+	Scene_fill(scene, light, &floor, 1);
+	return scene;
+}
+
+static Scene *CreateDemoScene(){
+	return CreateScene(0, NULL);
+}
+
+/**
+ * A grid of 64 pears on a floor, about 35k triangles.
+ */
+static Scene *CreatePearsScene(){
+	Material floorMaterial = Material_new(COLOR_BLUE, 0.05, COLOR_BLACK, 0, 0);
+	Model *floor = Model_createRectXZ(Point_init(-500, -10, -500), 1000, 1000, floorMaterial);
+	Light *light = Light_new(Point_init(0, 30, 10), 2, COLOR_WHITE);
+	Scene *scene = CreateBaseScene(Point_init(0, 10, 30), 0.45, floor, light);
+
+	int side = 8;
+	Model **pears = malloc(side * side * sizeof(Model*));
+	if(pears == NULL){
+		printf("ERROR::BENCH::CreatePearsScene::Failed to allocate memory for pears array\n");
+		return scene;
+	}
+	int numPears = 0;
+	for(int i = 0; i < side * side; i++){
+		Model *pear = Model_fromOBJ("models/pear.obj");
+		if(pear == NULL) break;
+		Point position = Point_new((i % side - side / 2) * 8, -10 + pear->boundingRadius, -(i / side) * 8);
+		Model_translate(pear, Vector_fromPoints(pear->center, &position));
+		pears[numPears++] = pear;
+	}
+	Scene_addModels(scene, pears, numPears);
+	free(pears);
+	return scene;
+}
+
+/**
+ * Hundreds of small spheres of random colors scattered on a floor.
+ */
+static Scene *CreateSpheresScene(){
+	Material floorMaterial = Material_new(COLOR_WHITE, 0.05, COLOR_BLACK, 0, 0);
+	Model *floor = Model_createRectXZ(Point_init(-500, -10, -500), 1000, 1000, floorMaterial);
+	Light *light = Light_new(Point_init(10, 40, 0), 3, COLOR_WHITE);
+	Scene *scene = CreateBaseScene(Point_init(0, 5, 25), 0.4, floor, light);
+
+	Sampler sampler;
+	Sampler_init(&sampler, 0, 0, SUITE_SEED);
+	int numSpheres = 400;
+	Model **spheres = malloc(numSpheres * sizeof(Model*));
+	if(spheres == NULL){
+		printf("ERROR::BENCH::CreateSpheresScene::Failed to allocate memory for spheres array\n");
+		return scene;
+	}
+	for(int i = 0; i < numSpheres; i++){
+		float radius = RandomRange(&sampler, 0.3, 1.5);
+		Color color = Color_fromRGB(RandomRange(&sampler, 0.2, 1), RandomRange(&sampler, 0.2, 1), RandomRange(&sampler, 0.2, 1));
+		Material material = Material_new(color, 0.05, Color_fromRGB(0.5, 0.5, 0.5), 32, 0);
+		Point *center = Point_init(RandomRange(&sampler, -30, 30), -10 + radius, RandomRange(&sampler, -60, 10));
+		spheres[i] = Model_createSphere(center, radius, material);
+	}
+	Scene_addModels(scene, spheres, numSpheres);
+	free(spheres);
+	return scene;
+}
+
+/**
+ * Mirror spheres between two facing mirror walls, most rays are reflected up to MAX_DEPTH times.
+ */
+static Scene *CreateReflectionsScene(){
+	Material floorMaterial = Material_new(COLOR_WHITE, 0.05, COLOR_BLACK, 0, 0.5);
+	Model *floor = Model_createRectXZ(Point_init(-500, -10, -500), 1000, 1000, floorMaterial);
+	Light *light = Light_new(Point_init(0, 20, 0), 2, COLOR_WHITE);
+	Scene *scene = CreateBaseScene(Point_init(0, 0, 15), 0, floor, light);
+
+	Material mirror = Material_new(COLOR_WHITE, 0.05, COLOR_WHITE, 64, 1);
+	Model *models[2 + 9];
+	models[0] = Model_createRectYZ(Point_init(-20, -10, -60), 40, 80, mirror);
+	models[1] = Model_createRectYZ(Point_init(20, -10, -60), 40, 80, mirror);
+	Color colors[3] = {COLOR_RED, COLOR_GREEN, COLOR_YELLOW};
+	for(int i = 0; i < 9; i++){
+		Material material = Material_new(colors[i % 3], 0.05, COLOR_WHITE, 64, 0.8);
+		models[2 + i] = Model_createSphere(Point_init((i % 3 - 1) * 10, -6, -10 - (i / 3) * 12), 4, material);
+	}
+	Scene_addModels(scene, models, 2 + 9);
+	return scene;
+}
+
+static const SuiteScene suiteScenes[] = {
+	{"demo", CreateDemoScene},
+	{"pears", CreatePearsScene},
+	{"spheres", CreateSpheresScene},
+	{"reflections", CreateReflectionsScene},
+};
+
+static void RunScene(FILE *output, const SuiteScene *suiteScene, ThreadPool *pool, uint32_t *pixels, int frames, bool last){
+	Scene *scene = suiteScene->create();
+	int numTriangles = 0;
+	for(unsigned int i = 0; i < scene->numModels; i++) numTriangles += scene->models[i]->numTriangles;
+
+	// a new renderer for each scene, so that every scene starts from the same frame index and seeds
+	Renderer *renderer = Renderer_new(pool);
+	if(renderer == NULL) exit(1);
+	// warm up the caches and the scratch buffers of the renderer
+	if(Renderer_render(renderer, scene, pixels, SUITE_WIDTH, SUITE_HEIGHT, SUITE_WIDTH, SUITE_ANTI_ALIASING) != 0) exit(1);
+	Renderer_resetCounters(renderer);
+
+	double start = GetTimeMs();
+	for(int i = 0; i < frames; i++){
+		if(Renderer_render(renderer, scene, pixels, SUITE_WIDTH, SUITE_HEIGHT, SUITE_WIDTH, SUITE_ANTI_ALIASING) != 0) exit(1);
+	}
+	double elapsed = GetTimeMs() - start;
+	RayCounters rays = Renderer_rayCounters(renderer);
+	double seconds = elapsed / 1000;
+
+	fprintf(output, "\t\t{\n");
+	fprintf(output, "\t\t\t\"name\": \"%s\",\n", suiteScene->name);
+	fprintf(output, "\t\t\t\"models\": %d,\n", scene->numModels);
+	fprintf(output, "\t\t\t\"triangles\": %d,\n", numTriangles);
+	fprintf(output, "\t\t\t\"wall_ms\": %.3f,\n", elapsed);
+	fprintf(output, "\t\t\t\"frame_ms\": %.3f,\n", elapsed / frames);
+	fprintf(output, "\t\t\t\"primary_rays\": %llu,\n", (unsigned long long)rays.primary);
+	fprintf(output, "\t\t\t\"shadow_rays\": %llu,\n", (unsigned long long)rays.shadow);
+	fprintf(output, "\t\t\t\"reflection_rays\": %llu,\n", (unsigned long long)rays.reflection);
+	fprintf(output, "\t\t\t\"primary_rays_per_second\": %.0f,\n", rays.primary / seconds);
+	fprintf(output, "\t\t\t\"shadow_rays_per_second\": %.0f,\n", rays.shadow / seconds);
+	fprintf(output, "\t\t\t\"reflection_rays_per_second\": %.0f,\n", rays.reflection / seconds);
+	fprintf(output, "\t\t\t\"rays_per_second\": %.0f,\n", (rays.primary + rays.shadow + rays.reflection) / seconds);
+	fprintf(output, "\t\t\t\"thread_utilization\": [");
+	for(int i = 0; i < pool->numWorkers; i++){
+		fprintf(output, "%s%.3f", i > 0 ? ", " : "", renderer->counters[i].busyTime / elapsed);
+	}
+	fprintf(output, "]\n");
+	fprintf(output, "\t\t}%s\n", last ? "" : ",");
+
+	Renderer_free(renderer);
+	fprintf(stderr, "%-12s %10.1f ms/frame\n", suiteScene->name, elapsed / frames);
+}
+
+int main(int argc, char **argv){
+	const char *path = argc > 1 ? argv[1] : NULL;
+	int workers = argc > 2 ? atoi(argv[2]) : 0;
+	int frames = argc > 3 ? atoi(argv[3]) : SUITE_FRAMES;
+	if(frames < 1) frames = 1;
+
+	FILE *output = stdout;
+	if(path != NULL){
+		output = fopen(path, "w");
+		if(output == NULL){
+			printf("ERROR::BENCH::main::Failed to open %s\n", path);
+			return 1;
+		}
+	}
+	uint32_t *pixels = malloc(SUITE_WIDTH * SUITE_HEIGHT * sizeof(uint32_t));
+	if(pixels == NULL){
+		printf("ERROR::BENCH::main::Failed to allocate memory for pixels\n");
+		return 1;
+	}
+	ThreadPool *pool = ThreadPool_new(workers);
+	if(pool == NULL) return 1;
+
+	int numScenes = sizeof(suiteScenes) / sizeof(suiteScenes[0]);
+	fprintf(output, "{\n");
+	fprintf(output, "\t\"width\": %d,\n", SUITE_WIDTH);
+	fprintf(output, "\t\"height\": %d,\n", SUITE_HEIGHT);
+	fprintf(output, "\t\"anti_aliasing\": %d,\n", SUITE_ANTI_ALIASING);
+	fprintf(output, "\t\"frames\": %d,\n", frames);
+	fprintf(output, "\t\"threads\": %d,\n", pool->numWorkers);
+	fprintf(output, "\t\"seed\": %d,\n", SUITE_SEED);
+	fprintf(output, "\t\"scenes\": [\n");
+	for(int i = 0; i < numScenes; i++){
+		RunScene(output, &suiteScenes[i], pool, pixels, frames, i == numScenes - 1);
+	}
+	fprintf(output, "\t]\n");
+	fprintf(output, "}\n");
+
+	if(output != stdout) fclose(output);
+	ThreadPool_free(pool);
+	free(pixels);
+	return 0;
+}
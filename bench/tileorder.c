@@ -0,0 +1,126 @@
+/**
+ * Compares the cache behaviour of the column order and of the Morton tile order.
+ * Both orders trace rays one by one, the tile order is also measured with the packets of the renderer (morton+pk).
+ *
+ * Usage: TileOrderBenchmark [width] [height] [frames] [workers] [model.obj ...]
+ *
+ * On Linux the L1 data cache and last level cache read misses are counted with perf_event_open,
+ * elsewhere (or when the counters are not accessible) only the wall time is reported.
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include"project.h"
+
+#ifdef __linux__
+#include<unistd.h>
+#include<sys/ioctl.h>
+#include<sys/syscall.h>
+#include<linux/perf_event.h>
+#endif
+
+#define NUM_COUNTERS 2
+
+typedef struct{
+	int fds[NUM_COUNTERS];
+	bool available;
+}CacheCounters;
+
+static const char *counterNames[NUM_COUNTERS] = {"L1D read misses", "LLC read misses"};
+
+#ifdef __linux__
+static int OpenCounter(uint64_t cache){
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HW_CACHE;
+	attr.config = cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// the worker threads are created after the counters are opened, so they inherit them
+	attr.inherit = 1;
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+static void CacheCounters_start(CacheCounters *counters){
+	counters->available = false;
+#ifdef __linux__
+	counters->fds[0] = OpenCounter(PERF_COUNT_HW_CACHE_L1D);
+	counters->fds[1] = OpenCounter(PERF_COUNT_HW_CACHE_LL);
+	counters->available = counters->fds[0] >= 0 && counters->fds[1] >= 0;
+	for(int i = 0; i < NUM_COUNTERS; i++){
+		if(counters->fds[i] < 0) continue;
+		ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+/** Must be called after the worker threads exited, inherited counts are only merged at thread exit. */
+static void CacheCounters_stop(CacheCounters *counters, uint64_t *values){
+	for(int i = 0; i < NUM_COUNTERS; i++) values[i] = 0;
+#ifdef __linux__
+	for(int i = 0; i < NUM_COUNTERS; i++){
+		if(counters->fds[i] < 0) continue;
+		ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+		if(read(counters->fds[i], &values[i], sizeof(uint64_t)) != sizeof(uint64_t)) values[i] = 0;
+		close(counters->fds[i]);
+	}
+#endif
+}
+
+static void RunBenchmark(const char *name, RenderOrder order, bool packets, Scene *scene, uint32_t *pixels, int width, int height, int frames, int workers){
+	CacheCounters counters;
+	uint64_t values[NUM_COUNTERS];
+
+	CacheCounters_start(&counters);
+	ThreadPool *pool = ThreadPool_new(workers);
+	Renderer *renderer = Renderer_new(pool);
+	if(pool == NULL || renderer == NULL) exit(1);
+	renderer->order = order;
+	renderer->packets = packets;
+
+	double start = GetTimeMs();
+	for(int i = 0; i < frames; i++){
+		if(Renderer_render(renderer, scene, pixels, width, height, width, 1) != 0) exit(1);
+	}
+	double elapsed = GetTimeMs() - start;
+
+	Renderer_free(renderer);
+	ThreadPool_free(pool);
+	CacheCounters_stop(&counters, values);
+
+	printf("%-10s %10.1f ms/frame", name, elapsed / frames);
+	for(int i = 0; i < NUM_COUNTERS; i++){
+		if(counters.available) printf("   %s: %12llu", counterNames[i], (unsigned long long)values[i]);
+		else printf("   %s: %12s", counterNames[i], "n/a");
+	}
+	printf("\n");
+}
+
+int main(int argc, char **argv){
+	int width = argc > 1 ? atoi(argv[1]) : 750;
+	int height = argc > 2 ? atoi(argv[2]) : 450;
+	int frames = argc > 3 ? atoi(argv[3]) : 5;
+	int workers = argc > 4 ? atoi(argv[4]) : 0;
+	int numObj = argc > 5 ? argc - 5 : 0;
+
+	Scene *scene = CreateScene(numObj, argv + 5);
+	uint32_t *pixels = malloc(width * height * sizeof(uint32_t));
+	if(pixels == NULL){
+		printf("ERROR::BENCH::main::Failed to allocate memory for pixels\n");
+		return 1;
+	}
+
+	printf("%dx%d, %d frames, %d workers\n", width, height, frames, workers > 0 ? workers : ThreadPool_numCores());
+	// warm up the caches and the page tables of the scene
+	RunBenchmark("warmup", RENDER_ORDER_TILES, false, scene, pixels, width, height, 1, workers);
+	RunBenchmark("columns", RENDER_ORDER_COLUMNS, false, scene, pixels, width, height, frames, workers);
+	RunBenchmark("morton", RENDER_ORDER_TILES, false, scene, pixels, width, height, frames, workers);
+	RunBenchmark("morton+pk", RENDER_ORDER_TILES, true, scene, pixels, width, height, frames, workers);
+
+	free(pixels);
+	return 0;
+}
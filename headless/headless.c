@@ -0,0 +1,109 @@
+/**
+ * Offline renderer without any window system.
+ *
+ * Usage: RayTracingHeadless <width> <height> <antiAliasingFactor> <output.ppm|png|pfm> [--heatmap=rays|tests|time] [--no-packets] [objects...]
+ *
+ * Renders the demo scene with the given OBJ models on all the cores, writes the image and prints
+ * the frame time and the ray throughput. With --heatmap the image shows the cost of every pixel instead of its color, with --no-packets
+ * the camera rays are traced one by one instead of by packets. If RAYTRACING_TRACE is set, a timeline of the frame is written
+ * to the file it names, as Chrome trace-event JSON.
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include"project.h"
+#include"image.h"
+
+static const char *heatmapNames[RENDER_NUM_MODES] = {NULL, "rays", "tests", "time"};
+
+int main(int argc, char **argv){
+	if(argc < 5){
+		printf("Usage: %s <width> <height> <antiAliasingFactor> <output.ppm|png|pfm> [--heatmap=rays|tests|time] [--no-packets] [objects...]\n", argv[0]);
+		return 1;
+	}
+	int width = atoi(argv[1]);
+	int height = atoi(argv[2]);
+	int antiAliasingFactor = atoi(argv[3]);
+	const char *output = argv[4];
+	if(width <= 0 || height <= 0){
+		printf("ERROR::HEADLESS::main::Invalid image size %dx%d\n", width, height);
+		return 1;
+	}
+	// checked before rendering, a frame can take long
+	if(!Image_isSupported(output)){
+		printf("ERROR::HEADLESS::main::Unsupported output format %s, use .ppm, .png or .pfm\n", output);
+		return 1;
+	}
+
+	RenderMode mode = RENDER_MODE_COLOR;
+	bool packets = true;
+	char **objects = argv + 5;
+	int numObjects = 0;
+	for(int i = 5; i < argc; i++){
+		if(strcmp(argv[i], "--no-packets") == 0){
+			packets = false;
+			continue;
+		}
+		if(strncmp(argv[i], "--heatmap=", 10) != 0){
+			objects[numObjects++] = argv[i];
+			continue;
+		}
+		mode = RENDER_NUM_MODES;
+		for(int m = RENDER_MODE_HEATMAP_RAYS; m < RENDER_NUM_MODES; m++){
+			if(strcmp(argv[i] + 10, heatmapNames[m]) == 0) mode = m;
+		}
+		if(mode == RENDER_NUM_MODES){
+			printf("ERROR::HEADLESS::main::Unknown heatmap %s\n", argv[i] + 10);
+			return 1;
+		}
+	}
+
+	Scene *scene = CreateScene(numObjects, objects);
+	uint32_t *pixels = malloc((size_t)width * height * sizeof(uint32_t));
+	if(pixels == NULL){
+		printf("ERROR::HEADLESS::main::Failed to allocate memory for pixels\n");
+		return 1;
+	}
+	ThreadPool *pool = ThreadPool_new(0);
+	if(pool == NULL) return 1;
+	Renderer *renderer = Renderer_new(pool);
+	if(renderer == NULL) return 1;
+	renderer->mode = mode;
+	renderer->packets = packets;
+
+	const char *tracePath = getenv("RAYTRACING_TRACE");
+	if(tracePath != NULL && Trace_begin(0) == 0) Trace_nameThread(TRACE_THREAD_RENDER, "render");
+
+	double start = GetTimeMs();
+	if(Renderer_render(renderer, scene, pixels, width, height, width, antiAliasingFactor) != 0) return 1;
+	double elapsed = GetTimeMs() - start;
+	Trace_complete("frame", TRACE_THREAD_RENDER, start, start + elapsed, NULL, 0);
+	if(tracePath != NULL && Trace_end(tracePath) == 0) printf("Trace written to %s\n", tracePath);
+
+	RayCounters rays = Renderer_rayCounters(renderer);
+	uint64_t totalRays = rays.primary + rays.shadow + rays.reflection;
+	printf("Rendered %dx%d (AA %d) on %d threads in %.1f ms, %s kernels\n", width, height, antiAliasingFactor, pool->numWorkers, elapsed,
+		Simd_levelName(Simd_level()));
+	printf("%llu rays (%llu primary, %llu shadow, %llu reflection), %.2f Mrays/s\n", (unsigned long long)totalRays,
+		(unsigned long long)rays.primary, (unsigned long long)rays.shadow, (unsigned long long)rays.reflection, totalRays / (elapsed * 1000));
+	RenderStats stats = Renderer_stats(renderer);
+	Stats_print(&stats);
+	ModelCosts costs = {NULL, 0};
+	if(Renderer_modelCosts(renderer, &costs) == 0) Stats_printModelCosts(&costs, scene, 10);
+	Stats_freeModelCosts(&costs);
+	for(int i = 0; i < pool->numWorkers; i++){
+		char label[32];
+		snprintf(label, sizeof(label), "worker %d", i);
+		PerfStages perf = Renderer_perf(renderer, i);
+		Perf_print(&perf, label);
+	}
+	if(mode != RENDER_MODE_COLOR) printf("Heatmap of %s, the hottest pixel costs %.0f\n", heatmapNames[mode], renderer->maxCost);
+
+	int result = Image_write(output, pixels, width, height);
+	if(result == 0) printf("Image written to %s\n", output);
+
+	Renderer_free(renderer);
+	ThreadPool_free(pool);
+	free(pixels);
+	return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include<stdbool.h>
+#include<stddef.h>
+#include"geometry.h"
+#include"packet.h"
+
+/** Maximum depth of a BVH, also the size of the traversal stack. */
+#define BVH_MAX_DEPTH 64
+
+/** Number of bins used to evaluate the surface area heuristic along each axis. */
+#define BVH_NUM_BINS 12
+
+/**
+ * Axis-aligned bounding box.
+ */
+typedef struct{
+	Point min, max;
+}AABB;
+
+/**
+ * A node of a flattened bounding volume hierarchy.
+ *
+ * Inner nodes store the index of their left child, the right child is always stored right after it.
+ * Leaves store a contiguous range of the BVH primitive array.
+ */
+typedef struct{
+	/** Bounds of everything below the node. */
+	AABB bounds;
+	/** Index of the left child for inner nodes, index of the first primitive for leaves. */
+	int leftFirst;
+	/** Number of primitives of a leaf, 0 for inner nodes. */
+	int count;
+}BVHNode;
+
+/**
+ * Bounding volume hierarchy built with the surface area heuristic (SAH).
+ *
+ * The BVH does not know anything about the primitives it holds, it only stores their indices.
+ * Primitives are tested by a BVHLeafTest callback supplied at traversal time.
+ */
+typedef struct{
+	/** Array of nodes, the root is nodes[0]. */
+	BVHNode *nodes;
+	/** Number of used nodes. */
+	int numNodes;
+	/** Primitive indices, ordered so that every leaf references a contiguous range. */
+	int *primitives;
+	/** Number of primitives. */
+	int numPrimitives;
+}BVH;
+
+/**
+ * @brief Tests the primitives of a BVH leaf against a ray.
+ *
+ * @param context User data passed to the traversal function.
+ * @param primitives Indices of the primitives of the leaf.
+ * @param count Number of primitives of the leaf.
+ * @param ray Pointer to the ray, its direction is normalized.
+ * @param tMax In: distance of the closest hit found so far. Out: updated if a closer hit is found.
+ *
+ * @return true if a hit closer than *tMax was found, false otherwise.
+ */
+typedef bool (*BVHLeafTest)(void *context, const int *primitives, int count, Line *ray, float *tMax);
+
+/**
+ * @brief Tests the primitives of a BVH leaf against some rays of a packet.
+ *
+ * @param context User data passed to the traversal function.
+ * @param primitives Indices of the primitives of the leaf.
+ * @param count Number of primitives of the leaf.
+ * @param packet Pointer to the packet, the tMax of the rays that find a closer hit must be updated.
+ * @param active Mask of the rays to test, only one ray when the packet has diverged.
+ *
+ * @return Mask of the rays that found a closer hit.
+ */
+typedef uint32_t (*BVHPacketLeafTest)(void *context, const int *primitives, int count, RayPacket *packet, uint32_t active);
+
+
+// ───── AABB ─────
+
+AABB    AABB_empty();
+AABB    AABB_fromPoint(Point p);
+AABB    AABB_union(AABB a, AABB b);
+AABB    AABB_extend(AABB box, Point p);
+Point   AABB_centroid(AABB box);
+float   AABB_surfaceArea(AABB box);
+
+/**
+ * @brief Slab test between a ray and a box.
+ *
+ * @param box Pointer to the box.
+ * @param origin Pointer to the origin of the ray.
+ * @param inverseDirection Component-wise inverse of the ray direction.
+ * @param tMax Maximum distance along the ray.
+ *
+ * @return The entry distance along the ray, or INFINITY if the ray misses the box within [0, tMax].
+ */
+float   AABB_intersect(const AABB *box, const Point *origin, Vector inverseDirection, float tMax);
+
+
+// ───── BVH ─────
+
+/**
+ * @brief Builds a BVH over a set of primitives using a binned surface area heuristic.
+ *
+ * @param bounds Array with the bounding box of each primitive.
+ * @param numPrimitives Number of primitives.
+ * @param maxLeafSize Maximum number of primitives a leaf may hold when a split is cheaper.
+ *
+ * @return Pointer to the allocated BVH, or NULL if numPrimitives is 0 or allocation fails.
+ */
+BVH    *BVH_build(const AABB *bounds, int numPrimitives, int maxLeafSize);
+
+/**
+ * @brief Finds the closest primitive hit by a ray.
+ *
+ * Children are visited front to back and subtrees farther than the closest hit found so far are skipped.
+ *
+ * @param bvh Pointer to the BVH.
+ * @param ray Pointer to the ray.
+ * @param tMax In: maximum distance along the ray. Out: distance of the closest hit.
+ * @param test Callback testing the primitives of a leaf.
+ * @param context User data forwarded to the callback.
+ *
+ * @return true if any primitive was hit, false otherwise.
+ */
+bool    BVH_intersect(const BVH *bvh, Line *ray, float *tMax, BVHLeafTest test, void *context);
+
+/**
+ * @brief Finds the closest primitive hit by every active ray of a packet.
+ *
+ * The rays traverse the hierarchy together: a node is skipped at once if it lies outside the frustum of the packet,
+ * otherwise only the rays entering its box go on. Once fewer than PACKET_MIN_ACTIVE rays are left in a subtree,
+ * each of them finishes it alone, front to back like BVH_intersect.
+ *
+ * @param bvh Pointer to the BVH.
+ * @param packet Pointer to the packet, its tMax are the maximum distances in input and the closest hits in output.
+ * @param active Mask of the rays to trace.
+ * @param test Callback testing the primitives of a leaf.
+ * @param context User data forwarded to the callback.
+ *
+ * @return Mask of the rays that hit any primitive.
+ */
+uint32_t BVH_intersectPacket(const BVH *bvh, RayPacket *packet, uint32_t active, BVHPacketLeafTest test, void *context);
+
+/**
+ * @brief Checks whether a ray segment hits any primitive of the BVH.
+ *
+ * Unlike BVH_intersect it does not look for the closest hit: traversal stops at the first leaf
+ * whose test reports a hit, so the callback should return as soon as it finds any blocker.
+ *
+ * @param bvh Pointer to the BVH.
+ * @param ray Pointer to the ray.
+ * @param tMax Length of the segment.
+ * @param test Callback testing the primitives of a leaf, the tMax it receives must not be modified.
+ * @param context User data forwarded to the callback.
+ *
+ * @return true if any primitive blocks the segment, false otherwise.
+ */
+bool    BVH_occluded(const BVH *bvh, Line *ray, float tMax, BVHLeafTest test, void *context);
+
+/**
+ * @brief Translates the bounds of every node of the BVH.
+ *
+ * @param bvh Pointer to the BVH.
+ * @param translation The translation vector.
+ */
+void    BVH_translate(BVH *bvh, Vector translation);
+
+/**
+ * @brief Returns the bounds of the whole hierarchy.
+ */
+AABB    BVH_bounds(const BVH *bvh);
+
+void    BVH_free(BVH *bvh);
+
+size_t  BVH_size(const BVH *bvh);
+
+#endif //BVH_H
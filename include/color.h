@@ -83,6 +83,15 @@ Color Color_average(Color* colors, int n);
 
 Color Color_multiply(Color c1, Color c2);
 
+/**
+ * Computes the contrast between two Colors as the largest difference between their RGB components.
+ *
+ * @param c1 The first Color.
+ * @param c2 The second Color.
+ * @return The contrast, in the range [0, 255].
+ */
+int Color_difference(Color c1, Color c2);
+
 int Color_size(Color color);
 
 #endif //COLOR_H
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef DEMOSCENE_H
+#define DEMOSCENE_H
+
+#include"scene.h"
+
+/**
+ * @brief Builds the demo scene: a floor, a few spheres and a light, plus optional OBJ models.
+ *
+ * The OBJ models are placed on the floor.
+ *
+ * @param numObj Number of OBJ files to load.
+ * @param objs Paths of the OBJ files.
+ *
+ * @return Pointer to the created scene.
+ */
+Scene *CreateScene(int numObj, char **objs);
+
+#endif //DEMOSCENE_H
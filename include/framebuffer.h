@@ -0,0 +1,79 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include<stdint.h>
+#include<stdbool.h>
+#include<stdatomic.h>
+#include<pthread.h>
+
+/** Set in Framebuffer.ready when the spare buffer holds a frame the presenter has not seen yet. */
+#define FRAMEBUFFER_FRESH 4
+
+/**
+ * Buffered image of packed 0xRRGGBB pixels shared by the renderer and the thread presenting the frames.
+ *
+ * The renderer draws in the back buffer and publishes it once complete, the presenter takes the
+ * latest published buffer as its front. A third, spare buffer is exchanged atomically between them,
+ * so the renderer never waits to publish a frame and neither side reads a buffer the other is writing.
+ *
+ * The mutex protects the allocation of the buffers: the presenter holds it from Framebuffer_acquire until it
+ * has finished reading the front buffer, and Framebuffer_resize takes it before freeing them. A resize thus
+ * waits for the frame being presented, and a frame is not presented while the buffers are reallocated.
+ */
+typedef struct{
+	uint32_t *buffers[3];
+	int width, height;
+	/** Buffer written by the renderer. */
+	int back;
+	/** Buffer read by the presenter. */
+	int front;
+	/** Index of the spare buffer, ORed with FRAMEBUFFER_FRESH when it holds an unseen frame. */
+	atomic_int ready;
+	pthread_mutex_t mutex;
+}Framebuffer;
+
+/**
+ * @brief Creates a framebuffer of the given size, cleared to black.
+ *
+ * @return Pointer to the allocated framebuffer or NULL if allocation fails.
+ */
+Framebuffer *Framebuffer_new(int width, int height);
+
+/**
+ * @brief Reallocates the buffers if the size changed, discarding their content.
+ *
+ * Must be called by the renderer between two frames. It waits for the presenter to release the front buffer.
+ *
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int Framebuffer_resize(Framebuffer *framebuffer, int width, int height);
+
+/**
+ * @brief Returns the buffer the renderer draws in, width pixels per row.
+ */
+uint32_t *Framebuffer_back(Framebuffer *framebuffer);
+
+/**
+ * @brief Hands the back buffer to the presenter and gives the renderer a new one.
+ *
+ * The content of the new back buffer is unspecified.
+ */
+void Framebuffer_publish(Framebuffer *framebuffer);
+
+/**
+ * @brief Makes the last published frame the front buffer.
+ *
+ * Called by the presenter with the mutex locked, which it keeps until it has read the front buffer.
+ *
+ * @return true if a frame was published since the previous call, false otherwise.
+ */
+bool Framebuffer_acquire(Framebuffer *framebuffer);
+
+/**
+ * @brief Returns the buffer the presenter reads, width pixels per row.
+ */
+const uint32_t *Framebuffer_front(const Framebuffer *framebuffer);
+
+void Framebuffer_free(Framebuffer *framebuffer);
+
+#endif //FRAMEBUFFER_H
@@ -11,7 +11,7 @@ typedef struct{
 }Point;
 
 typedef struct{
-	Point *origin;
+	Point origin;
 	Vector direction;
 }Line;
 
@@ -21,11 +21,12 @@ typedef struct{
 
 // Constructor
 Point*  Point_init(float x, float y, float z);
+Point   Point_new(float x, float y, float z);
 Point*  Point_copy(Point *p);
 
 // Operations
-float  Point_distanceSquared(Point *a, Point *b);
-Point*  Point_translate(Point *p, Vector v);
+float  Point_distanceSquared(const Point *a, const Point *b);
+Point   Point_translate(const Point *p, Vector v);
 
 // Debug
 void    Point_print(Point *p);
@@ -36,7 +37,7 @@ int     Point_size(Point *p);
 
 // Constructor
 Vector  Vector_init(float x, float y, float z);
-Vector  Vector_fromPoints(Point *a, Point *b);
+Vector  Vector_fromPoints(const Point *a, const Point *b);
 
 // Operations
 Vector  Vector_normalize(Vector v);
@@ -56,11 +57,11 @@ int	  Vector_size(Vector v);
 // ───── LINE ─────
 
 // Constructor
-Line*   Line_init(Point *origin, Vector direction);
+Line    Line_init(Point origin, Vector direction);
 
 // Operations
-float  Line_Point_distance(Line *l, Point *p);
-Point*  Line_projectionPoint(Line *l, Point *p);
+float  Line_Point_distance(const Line *l, const Point *p);
+Point   Line_projectionPoint(const Line *l, const Point *p);
 
 
 
@@ -0,0 +1,50 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include<stdint.h>
+#include<stdbool.h>
+
+/**
+ * @brief Writes an image of packed 0xRRGGBB pixels to a binary PPM (P6) file.
+ *
+ * @param path Path of the output file.
+ * @param pixels Pixels of the image, row-major, top row first.
+ * @param width Width of the image.
+ * @param height Height of the image.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int Image_writePPM(const char *path, const uint32_t *pixels, int width, int height);
+
+/**
+ * @brief Writes an image of packed 0xRRGGBB pixels to an 8-bit RGB PNG file.
+ *
+ * The image data is stored without compression, so no external library is needed.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int Image_writePNG(const char *path, const uint32_t *pixels, int width, int height);
+
+/**
+ * @brief Writes an image of packed 0xRRGGBB pixels to a little-endian PFM file, channels in [0, 1].
+ *
+ * The channels are the 8-bit values of the pixels divided by 255: the renderer shades with 8-bit colors,
+ * so the file holds no more precision than a PPM, only in a format float-based tools read directly.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int Image_writePFM(const char *path, const uint32_t *pixels, int width, int height);
+
+/**
+ * @brief Returns true if the extension of the path is one of the formats of Image_write (.ppm, .png, .pfm).
+ */
+bool Image_isSupported(const char *path);
+
+/**
+ * @brief Writes an image in the format given by the extension of the path: .ppm, .png or .pfm.
+ *
+ * @return 0 in case of success, -1 if the format is not supported or the file could not be written.
+ */
+int Image_write(const char *path, const uint32_t *pixels, int width, int height);
+
+#endif //IMAGE_H
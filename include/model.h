@@ -2,13 +2,22 @@
 #define MODEL_H
 
 #include<stdint.h>
+#include<limits.h>
 #include"geometry.h"
 #include"color.h"
 #include"triangle.h"
+#include"bvh.h"
+#include"trianglepack.h"
 
 #define LAT_DIVS 20
 #define LON_DIVS 20
 
+/** Maximum number of triangles in a leaf of a model BVH. */
+#define MODEL_BVH_LEAF_SIZE 8
+
+/** Maximum number of materials of a model, the material ids of the triangles are unsigned shorts. */
+#define MODEL_MAX_MATERIALS (USHRT_MAX + 1)
+
 /**
  * Represents the material properties of a 3D model.
  */
@@ -38,25 +47,56 @@ typedef enum{
  * A Model is a collection of triangles with shared material properties such as
  * color, reflectivity, and smoothness. It also includes spatial metadata like the
  * center point and a bounding radius for optimization (e.g., bounding sphere tests).
+ *
+ * Triangles are stored as an indexed mesh: vertices shared by several faces are stored once
+ * in a contiguous array, and every triangle is three indices into it plus a material index.
  */
 typedef struct{
 	/** Array of materials used by the model. */
 	Material *materials;
 	/** Number of materials used by the model. */
 	int numMaterials;
-	/** Number of triangles of the model. */
+	/** Number of vertices of the model. */
+	int numVertices;
+	/** Contiguous array of the vertices shared by the triangles. */
+	Point *vertices;
+	/** Number of triangles of the model, 0 for a sphere that has not been tessellated. */
 	int numTriangles;
-	/** Array of pointers to Triangle structure. */
-	Triangle **triangles;
+	/** Vertex indices, three consecutive entries per triangle. */
+	unsigned int *indices;
+	/** Material index of each triangle. */
+	unsigned short *triangleMaterials;
 	/** Center of the model. */
 	Point *center;
 	/** Maximum distance from the center to any point on the model (bounding radius). */
 	float boundingRadius;
 	/** Type of model. */
 	ModelType type;
+	/** Bounding volume hierarchy over the triangles, NULL for analytic models. */
+	BVH *bvh;
+	/** Triangles in the order of the BVH primitives, tested by the leaves of the BVH. */
+	TrianglePack *pack;
 }Model;
 
 
+/**
+ * @brief Builds the i-th triangle of a model from its indexed storage.
+ *
+ * @param model Pointer to the Model.
+ * @param i Index of the triangle, in [0, numTriangles).
+ *
+ * @return The triangle, with its vertices copied from the vertex array.
+ */
+static inline Triangle Model_getTriangle(const Model *model, int i){
+	const unsigned int *index = model->indices + 3 * i;
+	Triangle t;
+	t.a = model->vertices[index[0]];
+	t.b = model->vertices[index[1]];
+	t.c = model->vertices[index[2]];
+	t.material = model->triangleMaterials[i];
+	return t;
+}
+
 /**
  * Creates a rectangular model aligned to the X-Y plane.
  *
@@ -111,7 +151,9 @@ Model *Model_createRectYZ(Point *origin, float width, float height, Material mat
 Model *Model_createBox(Point *origin, float width, float height, float depth, Material material);
 
 /**
- * Creates a spherical model centered at the given point.
+ * Creates an analytic spherical model centered at the given point.
+ *
+ * The sphere has no triangles, it is intersected analytically. Call Model_tessellate to get a mesh.
  * 
  * @param center Pointer to the center point of the sphere.
  * @param radius The radius of the sphere.
@@ -122,6 +164,36 @@ Model *Model_createBox(Point *origin, float width, float height, float depth, Ma
  */
 Model *Model_createSphere(Point *center, float radius, Material material);
 
+/**
+ * @brief Generates the triangles of an analytic sphere (SPHERE or LIGHT model), LAT_DIVS x LON_DIVS quads.
+ *
+ * The mesh follows later translations and scales of the model, rendering keeps the analytic intersection.
+ * Models that already have triangles are left untouched.
+ *
+ * @param model Pointer to the Model.
+ *
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int Model_tessellate(Model *model);
+
+/**
+ * @brief (Re)builds the bounding volume hierarchy over the triangles of the model, and packs the triangles in its order.
+ * 
+ * It must be called every time the triangles of the model change.
+ * 
+ * @param model Pointer to the Model.
+ */
+void Model_buildBVH(Model *model);
+
+/**
+ * @brief Computes the axis-aligned bounding box of the model.
+ * 
+ * @param model Pointer to the Model.
+ * 
+ * @return The bounds of the model, the bounds of an analytic sphere enclose the whole sphere.
+ */
+AABB Model_getBounds(Model *model);
+
 /**
  * @brief Translates all vertices of the Model by a given vector.
  * 
@@ -141,6 +213,8 @@ void Model_scale(Model *model, float scalar);
 /**
  * @brief Sorts the triangles of a model by their distance to a reference point.
  *
+ * The BVH of the model is rebuilt after sorting.
+ *
  * @param model Pointer to the model whose triangles will be sorted.
  * @param point Reference point used to calculate distances.
  */
@@ -7,13 +7,15 @@
 
 /**
  * @brief Write a Model to a .obj file.
+ *
+ * Analytic spheres are tessellated first, see Model_tessellate.
  * 
  * @param model Pointer to the model to export.
  * @param fileName Path of the output .obj file.
  * 
- * @return 0 in case of success, -1 if the file could not be opened.
+ * @return 0 in case of success, -1 if the file could not be opened or the sphere could not be tessellated.
  */
-int Model_toOBJ(const Model *model, const char *fileName);
+int Model_toOBJ(Model *model, const char *fileName);
 
 /**
  * @brief Parses a Wavefront .obj file and creates a Model from it.
@@ -0,0 +1,54 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include<stdint.h>
+#include<stdbool.h>
+#include"geometry.h"
+
+/** Number of rays of a packet. */
+#define PACKET_SIZE 8
+
+/** The rays of a packet go through a block of PACKET_WIDTH x PACKET_HEIGHT cells, 8 consecutive Morton codes. */
+#define PACKET_WIDTH 4
+#define PACKET_HEIGHT 2
+
+/** Subtrees reached by fewer active rays than this are traversed by each ray alone. */
+#define PACKET_MIN_ACTIVE 2
+
+/**
+ * Rays sharing their origin and going through neighbouring cells of the image, traversed together.
+ *
+ * Sets of rays are bit masks, bit i standing for rays[i]. The directions are also stored one array per axis,
+ * so that the loops over the rays of a box test compile to SIMD instructions.
+ * The frustum bounds every ray of the packet: a box outside one of its planes is missed by all of them.
+ */
+typedef struct{
+	Line rays[PACKET_SIZE];
+	Point origin;
+	/** Inverse of the directions, one array per axis. */
+	float inverse[3][PACKET_SIZE];
+	/** Distance of the closest hit of every ray so far. */
+	float tMax[PACKET_SIZE];
+	/** Normals of the four side planes of the frustum, pointing inside. The planes go through the origin. */
+	Vector frustum[4];
+}RayPacket;
+
+/**
+ * @brief Initializes a packet of rays starting from the same origin.
+ *
+ * @param origin Origin of every ray.
+ * @param directions Direction of every ray, normalized like Line_init does.
+ * @param corners Directions along the four edges of a pyramid containing every ray, in order around it.
+ */
+void RayPacket_init(RayPacket *packet, Point origin, const Vector directions[PACKET_SIZE], const Vector corners[4]);
+
+/**
+ * @brief Returns the number of rays of a mask.
+ */
+static inline int RayPacket_count(uint32_t mask){
+	int count = 0;
+	for(; mask != 0; mask &= mask - 1) count++;
+	return count;
+}
+
+#endif //PACKET_H
@@ -0,0 +1,99 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include<stdint.h>
+#include<stdbool.h>
+
+/**
+ * Hardware performance counters of the render stages, collected only when the project is configured
+ * with RAYTRACING_PERF, on Linux (perf_event_open). Elsewhere the counters are never available.
+ *
+ * Every thread opens its own counters the first time it enters a stage. Stages nest: the counts between two
+ * boundaries go to the innermost stage, so the stages of a thread are exclusive and sum to its total.
+ * On x86 the counters are read in user space with rdpmc when the kernel allows it, otherwise every
+ * boundary costs a system call and the profile of the cheap stages is dominated by the measure itself.
+ */
+
+#ifdef RAYTRACING_PERF
+#define PERF_ENABLED 1
+#else
+#define PERF_ENABLED 0
+#endif
+
+typedef enum{
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_L1D_MISSES,
+	PERF_LLC_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_NUM_EVENTS
+}PerfEvent;
+
+typedef enum{
+	/** Tile loop, camera rays, sampling and anti-aliasing, everything of a task outside the other stages. */
+	PERF_STAGE_RENDER,
+	/** Closest hit traversal of the scene (Scene_intersection). */
+	PERF_STAGE_TRAVERSAL,
+	/** Shadow rays (CalculateShadowFactor). */
+	PERF_STAGE_SHADOW,
+	/** Lighting and reflections (the rest of TraceRayR). */
+	PERF_STAGE_SHADING,
+	/** Copying frames to the window. */
+	PERF_STAGE_PRESENT,
+	PERF_NUM_STAGES
+}PerfStage;
+
+/** Maximum nesting of the stages, the reflections of TraceRayR nest once per bounce. */
+#define PERF_MAX_NESTING 32
+
+/**
+ * Counts of the stages of a thread.
+ */
+typedef struct{
+	uint64_t counts[PERF_NUM_STAGES][PERF_NUM_EVENTS];
+}PerfStages;
+
+#ifdef RAYTRACING_PERF
+#define PERF_BEGIN(stage) Perf_begin(stage)
+#define PERF_END() Perf_end()
+#else
+#define PERF_BEGIN(stage) ((void)0)
+#define PERF_END() ((void)0)
+#endif
+
+/**
+ * @brief Enters a stage in the calling thread, opening its counters if needed.
+ */
+void Perf_begin(PerfStage stage);
+
+/**
+ * @brief Leaves the innermost stage of the calling thread.
+ */
+void Perf_end();
+
+/**
+ * @brief Returns true if the calling thread could open its counters.
+ */
+bool Perf_available();
+
+/**
+ * @brief Adds the counts collected by the calling thread to target and clears them.
+ *
+ * Must be called outside of any stage.
+ */
+void Perf_flush(PerfStages *target);
+
+void Perf_merge(PerfStages *target, const PerfStages *source);
+
+void Perf_reset(PerfStages *stages);
+
+const char *Perf_stageName(PerfStage stage);
+
+/**
+ * @brief Prints the counts, the IPC and the miss rates of every stage, does nothing without RAYTRACING_PERF.
+ *
+ * @param label Printed before the table, e.g. the name of the thread.
+ */
+void Perf_print(const PerfStages *stages, const char *label);
+
+#endif //PERF_H
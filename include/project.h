@@ -2,11 +2,23 @@
 #define PROJECT_H
 
 #include"model.h"
+#include"trianglepack.h"
+#include"spherepool.h"
+#include"simd.h"
 #include"geometry.h"
 #include"color.h"
 #include"raytracer.h"
 #include"scene.h"
 #include"objloader.h"
 #include"camera.h"
+#include"threadpool.h"
+#include"tiles.h"
+#include"sampler.h"
+#include"stats.h"
+#include"perf.h"
+#include"trace.h"
+#include"renderer.h"
+#include"framebuffer.h"
+#include"demoscene.h"
 
 #endif
\ No newline at end of file
@@ -5,12 +5,38 @@
 #include"model.h"
 #include"scene.h"
 #include"color.h"
+#include"sampler.h"
+#include"packet.h"
+#include<stdint.h>
 
 #define MAX_DEPTH 3
 #define BACKGROUND_COLOR Color_new(0xA7ECFF)
 
 typedef Line Ray;
 
+/**
+ * Closest intersection of a ray with a model or a scene.
+ */
+typedef struct{
+	Point point;
+	Vector normal;
+	Material material;
+	/** Distance from the ray origin to the hit point. */
+	float distance;
+
+	/** Model that was hit, NULL if the ray hit nothing. */
+	Model *model;
+}Hit;
+
+/**
+ * Number of rays traced, by kind. Each worker owns its counters.
+ */
+typedef struct{
+	uint64_t primary;
+	uint64_t shadow;
+	uint64_t reflection;
+}RayCounters;
+
 /**
  * Traces a single ray in the scene and returns the resulting color.
  *
@@ -18,8 +44,70 @@ typedef Line Ray;
  *
  * @param scene Pointer to the scene containing models and the light source.
  * @param l Pointer to the ray (Line) to trace.
+ * @param sampler Random stream of the pixel, used to sample the area light.
+ * @param counters Counters of the calling thread, incremented for every ray traced.
  * @return The computed Color seen along the ray.
  */
-Color TraceRay(Scene *scene, Line *l);
+Color TraceRay(Scene *scene, Line *l, Sampler *sampler, RayCounters *counters);
+
+/**
+ * Traces the active rays of a packet of camera rays and returns their colors.
+ *
+ * The primary rays traverse the scene together (see BVH_intersectPacket), the shadow and reflection rays
+ * they spawn are traced one by one. Every ray gets the color TraceRay would give it.
+ *
+ * @param scene Pointer to the scene.
+ * @param packet Pointer to the packet of primary rays.
+ * @param active Mask of the rays to trace.
+ * @param samplers Random stream of the pixel of every ray.
+ * @param counters Counters of the calling thread, incremented for every ray traced.
+ * @param colors Output, the color of every active ray.
+ */
+void TracePacket(Scene *scene, RayPacket *packet, uint32_t active, Sampler *samplers, RayCounters *counters, Color *colors);
+
+/**
+ * @brief Computes the closest intersection of a ray with a sphere model, analytically.
+ *
+ * @param tMax Hits at a distance greater or equal to tMax are ignored.
+ * @return The hit, its model is NULL if there is none.
+ */
+Hit Sphere_intersection(Model *sphere, Ray *ray, float tMax);
+
+/**
+ * @brief Returns true if a ray hits a sphere model at a distance in (tMin, tMax).
+ *
+ * @param ray Pointer to the ray, its direction must be normalized.
+ */
+bool Sphere_occluded(Model *sphere, Ray *ray, float tMin, float tMax);
+
+/**
+ * @brief Computes the closest intersection of a ray with a model, traversing its BVH.
+ *
+ * @return Same as Sphere_intersection.
+ */
+Hit Model_intersection(Model *model, Ray *ray, float tMax);
+
+/**
+ * @brief Computes the closest intersection of a ray with the models of a scene.
+ *
+ * @return Same as Sphere_intersection.
+ */
+Hit Scene_intersection(Scene *scene, Ray *ray, float tMax);
+
+/**
+ * @brief Computes the closest intersection of every active ray of a packet with the models of a scene.
+ *
+ * @param hits Output, one hit per ray of the packet, those of the inactive rays are left untouched.
+ */
+void Scene_intersectPacket(Scene *scene, RayPacket *packet, uint32_t active, Hit *hits);
+
+/**
+ * @brief Computes the fraction of the light source visible from a hit point, tracing shadow rays towards it.
+ *
+ * @param hit Shaded point, its normal must be normalized and face the incoming ray.
+ * @param vectorLight Normalized direction from the hit point to the center of the light.
+ * @return 1 if the point is fully lit, 0 if it is in the umbra.
+ */
+float CalculateShadowFactor(Scene *scene, Hit hit, Vector vectorLight, Sampler *sampler, RayCounters *counters);
 
 #endif //RAYTRACER_H
\ No newline at end of file
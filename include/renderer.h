@@ -0,0 +1,234 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include<stdint.h>
+#include<stdatomic.h>
+#include"scene.h"
+#include"color.h"
+#include"tiles.h"
+#include"threadpool.h"
+#include"raytracer.h"
+#include"stats.h"
+#include"perf.h"
+
+/** Side of the square screen tiles handed out to the thread pool, in pixels. */
+#define RENDERER_TILE_SIZE 16
+
+/** Returned by Renderer_render when the frame was cancelled before completion. */
+#define RENDERER_CANCELLED 1
+
+/** Side of the pixel blocks of the first pass of a progressive frame, 1/8 of the resolution. */
+#define RENDERER_PREVIEW_BLOCK_SIZE 8
+
+/**
+ * Pixels whose color differs from one of their neighbours by at least this much (see Color_difference)
+ * are supersampled by the anti-aliasing passes, the others keep their single sample.
+ */
+#define RENDERER_CONTRAST_THRESHOLD 16
+
+/** Maximum number of passes of a progressive frame. */
+#define RENDERER_MAX_PASSES 3
+
+/**
+ * Order in which the pixels of a frame are handed out to the workers.
+ */
+typedef enum{
+	/** Tiles along a Morton curve, pixels inside a tile along a Morton curve too. */
+	RENDER_ORDER_TILES,
+	/** One task per image column, top to bottom. Kept as a reference for benchmarks. */
+	RENDER_ORDER_COLUMNS
+}RenderOrder;
+
+/**
+ * What the pixels of a frame show.
+ */
+typedef enum{
+	/** The scene. */
+	RENDER_MODE_COLOR,
+	/** Heatmap of the number of rays traced for each pixel. */
+	RENDER_MODE_HEATMAP_RAYS,
+	/** Heatmap of the number of triangle and sphere tests of each pixel, black without RAYTRACING_STATS. */
+	RENDER_MODE_HEATMAP_TESTS,
+	/** Heatmap of the time spent on each pixel. */
+	RENDER_MODE_HEATMAP_TIME,
+	RENDER_NUM_MODES
+}RenderMode;
+
+/**
+ * One pass of a progressive frame.
+ */
+typedef struct{
+	/** Side of the square blocks of pixels sharing a single ray, a power of two up to RENDERER_TILE_SIZE. */
+	int blockSize;
+	/** Each pixel is sampled by a factor x factor grid of rays, only used when blockSize is 1. */
+	int antiAliasingFactor;
+	/** The pass refines the single sample pass that precedes it in the same frame, whose samples are reused. */
+	bool refine;
+}RenderPass;
+
+/** Size of a cache line, the counters of each worker are aligned to it. */
+#define RENDERER_CACHE_LINE 64
+
+/**
+ * Counters of a worker, padded to whole cache lines so that workers never write to the same line.
+ */
+typedef struct{
+	RayCounters rays;
+	/** Time spent rendering tasks, in milliseconds. */
+	double busyTime;
+	/** Flushed from the thread-local statistics of the worker after each task. */
+	RenderStats stats;
+	ModelCosts models;
+	/** Flushed from the hardware counters of the worker after each task. */
+	PerfStages perf;
+	char padding[RENDERER_CACHE_LINE - (sizeof(RayCounters) + sizeof(double) + sizeof(RenderStats) + sizeof(ModelCosts) + sizeof(PerfStages)) % RENDERER_CACHE_LINE];
+}WorkerCounters;
+
+/**
+ * Renders a Scene into a buffer of packed 0xRRGGBB pixels, independently of any window system.
+ *
+ * The renderer keeps its tile grid and its scratch buffers between frames, they are only
+ * reallocated when the frame size or the anti-aliasing factor grows.
+ */
+typedef struct{
+	ThreadPool *pool;
+	RenderOrder order;
+	RenderMode mode;
+	/** Traces the single sample passes of the tile order by packets of 8 rays (see TracePacket), true by default. */
+	bool packets;
+
+	Scene *scene;
+	uint32_t *pixels;
+	int width, height;
+	/** Number of pixels between the start of two rows of the buffer. */
+	int pitch;
+	int antiAliasingFactor;
+	int blockSize;
+	float viewportWidth, viewportHeight;
+
+	/**
+	 * Pixels whose contrast with a neighbour reaches this threshold are supersampled, the others keep the color
+	 * of their single sample. 0 supersamples every pixel.
+	 */
+	int contrastThreshold;
+
+	TileGrid tiles;
+	/** Single sample color of every pixel, width pixels per row. */
+	uint32_t *base;
+	int baseCapacity;
+	/** Generation and size of the last complete single sample pass, to know if base can be reused. */
+	unsigned int baseGeneration;
+	int baseWidth, baseHeight;
+	/** Set while the supersampling stage of an adaptive pass runs. */
+	bool adaptive;
+	/** Cost of every pixel in the unit of the heatmap mode, width pixels per row. */
+	float *costs;
+	int costsCapacity;
+	/** Highest pixel cost of the last heatmap, mapped to the hottest color. */
+	float maxCost;
+	/** Scratch space for the anti-aliasing samples of a pixel, one slice per worker. */
+	Color *samples;
+	int samplesCapacity;
+	/** One per worker of the pool, aligned to a cache line inside countersMemory. */
+	WorkerCounters *counters;
+	void *countersMemory;
+
+	/** Incremented by Renderer_cancel, a frame stops as soon as it differs from frameGeneration. */
+	atomic_uint generation;
+	unsigned int frameGeneration;
+	/** Index of the current pass, seeds the random streams of the pixels. */
+	unsigned int frame;
+}Renderer;
+
+/**
+ * @brief Creates a renderer running on the given pool.
+ *
+ * @return Pointer to the allocated renderer or NULL if allocation fails.
+ */
+Renderer *Renderer_new(ThreadPool *pool);
+
+/**
+ * @brief Renders a frame of the scene and waits for it to complete.
+ *
+ * @param renderer Pointer to the renderer.
+ * @param scene Pointer to the scene, seen from its camera.
+ * @param pixels Destination buffer, at least pitch * height pixels.
+ * @param width Width of the frame in pixels.
+ * @param height Height of the frame in pixels.
+ * @param pitch Number of pixels between the start of two rows of the buffer.
+ * @param antiAliasingFactor Each pixel is sampled by a factor x factor grid of rays.
+ *
+ * @return 0 in case of success, RENDERER_CANCELLED if Renderer_cancel was called during the frame,
+ * -1 if allocation fails.
+ */
+int Renderer_render(Renderer *renderer, Scene *scene, uint32_t *pixels, int width, int height, int pitch, int antiAliasingFactor);
+
+/**
+ * @brief Renders a single pass of a progressive frame and waits for it to complete.
+ *
+ * A pass with a block size greater than 1 traces one ray per block and fills the whole block with its color,
+ * so it gives a coarse preview of the frame at a fraction of the cost.
+ *
+ * An anti-aliased pass is adaptive: it first traces one sample per pixel (or reuses those of the previous
+ * pass if it refines it), then supersamples only the pixels in contrast with one of their neighbours.
+ * The column order ignores the block size and always renders at full resolution.
+ *
+ * @return Same as Renderer_render.
+ */
+int Renderer_renderPass(Renderer *renderer, Scene *scene, uint32_t *pixels, int width, int height, int pitch, RenderPass pass);
+
+/**
+ * @brief Computes the passes of a progressive frame: a 1/8 resolution preview, the full resolution
+ * and, if antiAliasingFactor is greater than 1, the anti-aliased frame.
+ *
+ * @param antiAliasingFactor Anti-aliasing factor of the final pass.
+ * @param passes Output, room for RENDERER_MAX_PASSES passes.
+ *
+ * @return The number of passes.
+ */
+int Renderer_progressivePasses(int antiAliasingFactor, RenderPass *passes);
+
+/**
+ * @brief Cancels the frame in progress, if any.
+ *
+ * Safe to call from any thread. The workers drop their remaining pixels and Renderer_render returns
+ * RENDERER_CANCELLED, leaving the content of the buffer unspecified.
+ */
+void Renderer_cancel(Renderer *renderer);
+
+/**
+ * @brief Returns the number of rays traced by all the workers since the renderer was created or its counters were reset.
+ */
+RayCounters Renderer_rayCounters(const Renderer *renderer);
+
+/**
+ * @brief Returns the statistics of all the workers since the renderer was created or its counters were reset.
+ *
+ * Every field is 0 unless the project is configured with RAYTRACING_STATS.
+ */
+RenderStats Renderer_stats(const Renderer *renderer);
+
+/**
+ * @brief Adds the intersection cost of every model queried by the workers to costs.
+ *
+ * Costs are only collected if the project is configured with RAYTRACING_STATS.
+ *
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int Renderer_modelCosts(const Renderer *renderer, ModelCosts *costs);
+
+/**
+ * @brief Returns the hardware counters of the stages of a worker, or of all the workers if worker is negative.
+ *
+ * Every count is 0 unless the project is configured with RAYTRACING_PERF and the counters are accessible.
+ */
+PerfStages Renderer_perf(const Renderer *renderer, int worker);
+
+/**
+ * @brief Clears the ray counters, the busy times, the statistics, the model costs and the hardware counters of the workers. Must not be called during a frame.
+ */
+void Renderer_resetCounters(Renderer *renderer);
+
+void Renderer_free(Renderer *renderer);
+
+#endif //RENDERER_H
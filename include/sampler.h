@@ -0,0 +1,65 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include<stdint.h>
+
+/**
+ * Random number stream of a single pixel (PCG32).
+ *
+ * A sampler is seeded from the pixel coordinates and the frame index, and lives on the stack of the
+ * worker rendering the pixel. Workers never share random state, and a frame is bit-identical whatever
+ * the number of threads or the order in which the pixels are rendered.
+ *
+ * Sets of samples that are integrated together (the sub-pixel positions of a pixel, the light points
+ * seen from a shaded point) should use a low-discrepancy sequence instead of independent random numbers:
+ * draw one seed from the stream with Sampler_nextUInt, then take the points of Sampler_sobol2D for that seed.
+ */
+typedef struct{
+	uint64_t state;
+	/** Selects the stream, always odd. */
+	uint64_t increment;
+}Sampler;
+
+/**
+ * @brief Seeds the stream of a pixel.
+ *
+ * @param sampler Pointer to the Sampler.
+ * @param x Column of the pixel.
+ * @param y Row of the pixel.
+ * @param frame Index of the frame, so that consecutive frames get different noise.
+ */
+void Sampler_init(Sampler *sampler, uint32_t x, uint32_t y, uint32_t frame);
+
+/**
+ * @brief Returns the next 32 random bits of the stream.
+ */
+static inline uint32_t Sampler_nextUInt(Sampler *sampler){
+	uint64_t old = sampler->state;
+	sampler->state = old * 6364136223846793005ULL + sampler->increment;
+	uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	uint32_t rotation = (uint32_t)(old >> 59);
+	return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+}
+
+/**
+ * @brief Returns a uniformly distributed float in [0, 1).
+ */
+static inline float Sampler_next1D(Sampler *sampler){
+	return (Sampler_nextUInt(sampler) >> 8) * 0x1p-24f;
+}
+
+/**
+ * @brief Returns a point of a 2D Sobol sequence with Owen scrambling.
+ *
+ * For a given seed, the first 2^(2n) points of the sequence put exactly one point in each cell of the
+ * 2^n x 2^n grid (and of every other grid of 2^(2n) cells of equal size), so any prefix is well stratified
+ * and sampling can stop early. Different seeds give independent scramblings.
+ *
+ * @param index Index of the point in the sequence.
+ * @param seed Scrambling seed, one per set of samples.
+ * @param u Output, first coordinate in [0, 1).
+ * @param v Output, second coordinate in [0, 1).
+ */
+void Sampler_sobol2D(uint32_t index, uint32_t seed, float *u, float *v);
+
+#endif //SAMPLER_H
@@ -7,6 +7,16 @@
 #include"geometry.h"
 #include"model.h"
 #include"camera.h"
+#include"bvh.h"
+#include"spherepool.h"
+
+/** Maximum number of models in a leaf of the scene BVH. */
+#define SCENE_BVH_LEAF_SIZE 2
+
+/** Default maximum number of shadow rays traced towards an area light from a point. */
+#define LIGHT_DEFAULT_SHADOW_SAMPLES 16
+/** Default standard error of the visible fraction of an area light at which shadow sampling stops. */
+#define LIGHT_DEFAULT_SHADOW_THRESHOLD 0.1f
 
 typedef struct{
 	Point *position;
@@ -14,6 +24,11 @@ typedef struct{
 	Color color;
 
 	float constant, linear, quadratic;
+
+	/** Maximum number of shadow rays per shaded point, only used if radius > 0. */
+	int shadowSamples;
+	/** Shadow sampling stops once the standard error of the estimated visibility is below this value. */
+	float shadowThreshold;
 }Light;
 
 /**
@@ -30,6 +45,14 @@ typedef struct{
 	unsigned int numModels;
 	/** Pointer to the light source of the scene. */
 	Light *lightSource;
+	/** Top-level bounding volume hierarchy over the bounds of the models. */
+	BVH *bvh;
+	/** Top-level bounding volume hierarchy over the models that cast shadows, LIGHT models are left out. */
+	BVH *occluderBVH;
+	/** Spheres of the models of bvh, in the order of its primitives. */
+	SpherePool *spheres;
+	/** Spheres of the models of occluderBVH, in the order of its primitives. */
+	SpherePool *occluderSpheres;
 }Scene;
 
 
@@ -70,9 +93,20 @@ void Scene_addModels(Scene *s, Model **models, int numModels);
 
 /**
  * @brief Sort models in a scene based on the distance between the model center and the camera position
+ *
+ * The top-level BVH is rebuilt after sorting, since it refers to models by index.
  */
 void Scene_sortModels(Scene *s);
 
+/**
+ * @brief (Re)builds the top-level BVHs over the models of the scene, and the pools of their spheres.
+ *
+ * It is called by Scene_fill and Scene_addModels, and must be called again if a model of the scene is moved.
+ *
+ * @param s Pointer to the Scene.
+ */
+void Scene_buildBVH(Scene *s);
+
 size_t Scene_size(Scene *s);
 
 
@@ -80,4 +114,16 @@ Light *Light_new(Point *position, float radius, Color lightColor);
 
 void Light_setAttenuation(Light *light, float constant, float linear, float quadratic);
 
+/**
+ * @brief Configures the soft shadow sampling of an area light.
+ *
+ * Shadow rays are traced in batches towards stratified points of the light disk. Sampling stops after the
+ * first batch if all the rays agree (fully lit or umbra), or as soon as the estimate has converged.
+ *
+ * @param light Pointer to the Light.
+ * @param maxSamples Maximum number of shadow rays per shaded point.
+ * @param threshold Standard error of the estimated visibility below which sampling stops.
+ */
+void Light_setShadowSampling(Light *light, int maxSamples, float threshold);
+
 #endif //SCENE_H
\ No newline at end of file
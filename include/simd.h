@@ -0,0 +1,71 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include<stdbool.h>
+
+/**
+ * Instruction sets of the SIMD kernels (TrianglePack, SpherePool).
+ *
+ * The widest level supported by the CPU is selected from cpuid the first time a packed structure is created,
+ * and every kernel then runs at that level. All the levels report the same hits at the same distances.
+ */
+typedef enum{
+	SIMD_SCALAR,
+	SIMD_SSE41,
+	SIMD_AVX2,
+	SIMD_NUM_LEVELS
+}SimdLevel;
+
+/** Level read by the kernels on every call, SIMD_SCALAR until one is selected. Change it with Simd_setLevel. */
+extern SimdLevel simdLevel;
+
+/**
+ * @brief Returns true if the CPU and the build support a level.
+ */
+bool Simd_supported(SimdLevel level);
+
+/**
+ * @brief Selects the widest supported level, unless one has already been selected.
+ */
+void Simd_init();
+
+/**
+ * @brief Returns the level in use, selecting the widest supported one if none has been selected yet.
+ */
+SimdLevel Simd_level();
+
+/**
+ * @brief Forces a level, e.g. to compare the kernels.
+ *
+ * @return 0 in case of success, -1 if the level is not supported.
+ */
+int Simd_setLevel(SimdLevel level);
+
+const char *Simd_levelName(SimdLevel level);
+
+
+// Helpers of the translation units implementing kernels
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_X86 1
+#include<immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+// the kernels are compiled for their instruction set only, the rest of the project keeps the baseline flags
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#define SIMD_LOWEST_LANE(mask) __builtin_ctz(mask)
+#else
+#include<intrin.h>
+// MSVC accepts every intrinsic without flags
+#define SIMD_TARGET(isa)
+static inline int Simd_lowestLane(unsigned mask){
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+}
+#define SIMD_LOWEST_LANE(mask) Simd_lowestLane(mask)
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+#endif //SIMD_H
@@ -0,0 +1,78 @@
+#ifndef SPHEREPOOL_H
+#define SPHEREPOOL_H
+
+#include<stdbool.h>
+#include<stddef.h>
+#include"geometry.h"
+#include"model.h"
+
+/**
+ * Analytic spheres of a scene gathered for SIMD intersection tests.
+ *
+ * Centers and squared radii have one array per coordinate (structure of arrays), stored in the order of the
+ * primitives of a top-level BVH, so a leaf is a contiguous range of the pool. Positions holding a mesh keep
+ * their model but never hit, the kernels test a whole leaf without looking at the models.
+ *
+ * The kernel follows the SIMD level (see simd.h): AVX2 tests 8 spheres at a time, SSE4.1 tests 4 and the scalar
+ * kernel tests one. Every kernel performs the operations of Sphere_intersection and Sphere_occluded in the same
+ * order, so they all report the same hits at the same distances.
+ */
+
+/** Number of spheres tested at once by the widest kernel, also the padding at the end of the arrays. */
+#define SPHERE_POOL_WIDTH 8
+
+typedef struct{
+	/** Coordinates x, y, z of the centers. */
+	float *center[3];
+	/** Squared radii, clamped to 0.1 like Sphere_intersection. -INFINITY for meshes and padding. */
+	float *radiusSquared;
+	/** Model at every position, spheres and meshes. */
+	Model **models;
+	/** Number of positions. */
+	int count;
+}SpherePool;
+
+/**
+ * @brief Allocates a pool of count positions, selecting the SIMD level if none has been selected yet.
+ *
+ * @return Pointer to the pool, or NULL if count is 0 or allocation fails.
+ */
+SpherePool *SpherePool_new(int count);
+
+/**
+ * @brief Stores a model at position i of the pool, only SPHERE and LIGHT models are tested by the kernels.
+ */
+void SpherePool_set(SpherePool *pool, int i, Model *model);
+
+/**
+ * @brief Returns true if position i of the pool holds a sphere.
+ */
+static inline bool SpherePool_isSphere(const SpherePool *pool, int i){
+	return pool->radiusSquared[i] >= 0;
+}
+
+/**
+ * @brief Finds the closest sphere of a range of the pool hit by a ray.
+ *
+ * @param first Position of the first sphere of the range.
+ * @param count Number of positions of the range.
+ * @param ray Pointer to the ray.
+ * @param tMax In: distance of the closest hit found so far. Out: updated if a closer hit is found.
+ *
+ * @return Position in the pool of the closest sphere hit before tMax, -1 if none.
+ */
+int SpherePool_intersect(const SpherePool *pool, int first, int count, Line *ray, float *tMax);
+
+/**
+ * @brief Returns true if the ray hits a sphere of a range of the pool, other than ignore, at a distance in (tMin, tMax).
+ *
+ * @param ray Pointer to the ray, its direction must be normalized.
+ * @param ignore Model never considered a blocker, can be NULL.
+ */
+bool SpherePool_occluded(const SpherePool *pool, int first, int count, Line *ray, float tMin, float tMax, const Model *ignore);
+
+size_t SpherePool_size(const SpherePool *pool);
+
+void SpherePool_free(SpherePool *pool);
+
+#endif //SPHEREPOOL_H
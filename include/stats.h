@@ -0,0 +1,161 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include<stdint.h>
+#include"utils.h"
+#include"scene.h"
+
+/**
+ * Render statistics, collected only when the project is configured with RAYTRACING_STATS.
+ *
+ * Every thread counts in its own thread-local RenderStats through the STATS_* macros, then moves them
+ * with Stats_flush to a RenderStats it owns (the renderer flushes after every task, into the slot of the worker).
+ * Without RAYTRACING_STATS the macros expand to nothing and every RenderStats stays zeroed.
+ */
+
+#ifdef RAYTRACING_STATS
+#define STATS_ENABLED 1
+#else
+#define STATS_ENABLED 0
+#endif
+
+typedef enum{
+	/** Ray-triangle tests, closest hit and occlusion. */
+	STAT_TRIANGLE_TESTS,
+	/** Ray-sphere tests, closest hit and occlusion. */
+	STAT_SPHERE_TESTS,
+	/** Closest hit queries rejected by the root bounds of a BVH before any primitive test. */
+	STAT_BOUNDS_REJECTS,
+	/** Area light estimates that converged before their maximum number of shadow rays. */
+	STAT_SHADOW_EARLY_OUTS,
+	STAT_NUM_COUNTERS
+}StatCounter;
+
+typedef enum{
+	/** Tracing rays, shading included (TraceRayR). */
+	STAT_TIMER_TRACE,
+	/** Sampling the light visibility (CalculateShadowFactor), also part of STAT_TIMER_TRACE. */
+	STAT_TIMER_SHADOW,
+	/** Copying frames to the window. */
+	STAT_TIMER_PRESENT,
+	STAT_NUM_TIMERS
+}StatTimer;
+
+typedef struct{
+	uint64_t counters[STAT_NUM_COUNTERS];
+	/** In milliseconds, summed over the threads. */
+	double timers[STAT_NUM_TIMERS];
+}RenderStats;
+
+/**
+ * Intersection work spent on a model of the scene, closest hit and occlusion queries.
+ */
+typedef struct{
+	uint64_t queries;
+	/** In milliseconds, summed over the threads. */
+	double time;
+}ModelCost;
+
+/**
+ * Cost of every model of a scene, indexed like scene->models. Grows as models are queried.
+ */
+typedef struct{
+	ModelCost *costs;
+	int count;
+}ModelCosts;
+
+#ifdef RAYTRACING_STATS
+extern _Thread_local RenderStats threadStats;
+extern _Thread_local ModelCosts threadModelCosts;
+
+#define STATS_INCREMENT(counter) (threadStats.counters[counter]++)
+#define STATS_ADD(counter, value) (threadStats.counters[counter] += (value))
+#define STATS_TIMER_START(name) double name##Start = GetTimeMs()
+#define STATS_TIMER_STOP(timer, name) (threadStats.timers[timer] += GetTimeMs() - name##Start)
+#define STATS_MODEL_START() double modelStart = GetTimeMs()
+#define STATS_MODEL_STOP(index) Stats_addModelCost(&threadModelCosts, index, 1, GetTimeMs() - modelStart)
+#define STATS_SPHERES_STOP(pool, models, first, count) Stats_addSphereCosts(&threadStats, &threadModelCosts, pool, models, first, count, GetTimeMs() - modelStart)
+#else
+#define STATS_INCREMENT(counter) ((void)0)
+#define STATS_ADD(counter, value) ((void)0)
+#define STATS_TIMER_START(name) ((void)0)
+#define STATS_TIMER_STOP(timer, name) ((void)0)
+#define STATS_MODEL_START() ((void)0)
+#define STATS_MODEL_STOP(index) ((void)0)
+#define STATS_SPHERES_STOP(pool, models, first, count) ((void)0)
+#endif
+
+/**
+ * @brief Returns a counter of the calling thread since its last flush, 0 without RAYTRACING_STATS.
+ */
+static inline uint64_t Stats_threadCounter(StatCounter counter){
+#ifdef RAYTRACING_STATS
+	return threadStats.counters[counter];
+#else
+	(void)counter;
+	return 0;
+#endif
+}
+
+/**
+ * @brief Adds the statistics collected by the calling thread to target and clears them.
+ */
+void Stats_flush(RenderStats *target);
+
+/**
+ * @brief Adds the model costs collected by the calling thread to target and clears them.
+ *
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int Stats_flushModelCosts(ModelCosts *target);
+
+/**
+ * @brief Adds queries and time to the cost of the model of the given index, growing costs if needed.
+ *
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int Stats_addModelCost(ModelCosts *costs, int index, uint64_t queries, double time);
+
+/**
+ * @brief Counts the sphere tests of a leaf tested at once and shares the time between its spheres.
+ *
+ * @param pool Pool of the spheres of the leaf.
+ * @param models Models of the leaf, indices in scene->models.
+ * @param first Position of the leaf in the pool.
+ * @param count Number of models of the leaf.
+ *
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int Stats_addSphereCosts(RenderStats *stats, ModelCosts *costs, const SpherePool *pool, const int *models, int first, int count, double time);
+
+/**
+ * @brief Zeroes every cost, keeping the array.
+ */
+void Stats_resetModelCosts(ModelCosts *costs);
+
+void Stats_freeModelCosts(ModelCosts *costs);
+
+/**
+ * @brief Adds the statistics of source to target.
+ */
+void Stats_merge(RenderStats *target, const RenderStats *source);
+
+void Stats_reset(RenderStats *stats);
+
+const char *Stats_counterName(StatCounter counter);
+
+const char *Stats_timerName(StatTimer timer);
+
+/**
+ * @brief Prints every counter and timer on a line, does nothing without RAYTRACING_STATS.
+ */
+void Stats_print(const RenderStats *stats);
+
+/**
+ * @brief Prints the models of the scene sorted by intersection time, does nothing without RAYTRACING_STATS.
+ *
+ * @param maxModels Number of models printed, the most expensive first.
+ */
+void Stats_printModelCosts(const ModelCosts *costs, const Scene *scene, int maxModels);
+
+#endif //STATS_H
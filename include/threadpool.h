@@ -0,0 +1,99 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include<pthread.h>
+#include<stdatomic.h>
+#include<stdbool.h>
+
+/**
+ * @brief Function executed by the pool for every task of a job.
+ *
+ * @param context User data passed to ThreadPool_run.
+ * @param task Index of the task, in [0, numTasks).
+ * @param worker Index of the worker running the task, in [0, numWorkers).
+ */
+typedef void (*ThreadPoolTask)(void *context, int task, int worker);
+
+/**
+ * Lock-free double-ended queue of task indices (Chase-Lev).
+ *
+ * The owner worker pops from the bottom, the other workers steal from the top.
+ * Tasks are only pushed between two jobs, while no worker is running.
+ */
+typedef struct{
+	atomic_int top;
+	atomic_int bottom;
+	/** Task indices, valid in [top, bottom). */
+	int *tasks;
+	int capacity;
+}TaskDeque;
+
+struct ThreadPool;
+
+typedef struct{
+	struct ThreadPool *pool;
+	int index;
+	pthread_t thread;
+	TaskDeque deque;
+}Worker;
+
+/**
+ * Persistent pool of worker threads.
+ *
+ * Threads are created once and sleep between jobs. The tasks of a job are split in contiguous
+ * ranges, one per worker deque, and a worker whose deque is empty steals from the others.
+ */
+typedef struct ThreadPool{
+	Worker *workers;
+	int numWorkers;
+
+	pthread_mutex_t mutex;
+	/** Signaled when a new job is published or the pool is shutting down. */
+	pthread_cond_t jobReady;
+	/** Signaled by the last worker finishing a job. */
+	pthread_cond_t jobDone;
+	/** Incremented for every job, workers compare it with the last job they ran. */
+	unsigned int jobId;
+	/** Number of workers still running the current job. */
+	int activeWorkers;
+	bool shutdown;
+
+	ThreadPoolTask task;
+	void *context;
+}ThreadPool;
+
+/**
+ * @brief Returns the number of logical cores available to the process.
+ */
+int ThreadPool_numCores();
+
+/**
+ * @brief Creates a pool and starts its worker threads.
+ *
+ * @param numWorkers Number of threads, if less than 1 the detected core count is used.
+ *
+ * @return Pointer to the allocated pool or NULL if allocation fails or a thread cannot be started.
+ */
+ThreadPool *ThreadPool_new(int numWorkers);
+
+/**
+ * @brief Runs numTasks tasks on the pool and waits for all of them to finish.
+ *
+ * Each worker starts from its own contiguous range of task indices, processed in ascending order.
+ * Idle workers steal from the end of the other ranges.
+ *
+ * @param pool Pointer to the pool.
+ * @param numTasks Number of tasks.
+ * @param task Function called once per task.
+ * @param context User data forwarded to the task function.
+ *
+ * @return 0 once every task has run, -1 if the pool is NULL or the deques cannot be allocated, no task is run then.
+ */
+int ThreadPool_run(ThreadPool *pool, int numTasks, ThreadPoolTask task, void *context);
+
+/**
+ * @brief Stops and joins the worker threads and frees the pool.
+ */
+void ThreadPool_free(ThreadPool *pool);
+
+#endif //THREADPOOL_H
@@ -0,0 +1,59 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include<stdint.h>
+
+/**
+ * A rectangular block of pixels of the image.
+ */
+typedef struct{
+	int x, y;
+	int width, height;
+}Tile;
+
+/**
+ * Splits an image in square tiles and orders them along a Morton (Z-order) curve.
+ *
+ * Consecutive tiles of the order are close to each other on screen, so a worker processing
+ * a contiguous range of them touches a compact region of the scene.
+ */
+typedef struct{
+	int width, height;
+	/** Side of a tile in pixels, a power of two. */
+	int tileSize;
+	int tilesX, tilesY;
+	int numTiles;
+	/** Tile indices (row-major) sorted by Morton code. */
+	int *order;
+}TileGrid;
+
+/**
+ * @brief Interleaves the bits of x and y into a Morton code.
+ */
+uint32_t Morton_encode(uint32_t x, uint32_t y);
+
+/**
+ * @brief Splits a Morton code into its x and y coordinates.
+ */
+void Morton_decode(uint32_t code, uint32_t *x, uint32_t *y);
+
+/**
+ * @brief Initializes the grid and computes the Morton order of its tiles.
+ *
+ * @param grid Pointer to the grid.
+ * @param width Width of the image in pixels.
+ * @param height Height of the image in pixels.
+ * @param tileSize Side of a tile in pixels, rounded up to a power of two.
+ *
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int TileGrid_init(TileGrid *grid, int width, int height, int tileSize);
+
+/**
+ * @brief Returns the i-th tile in Morton order, clipped to the image.
+ */
+Tile TileGrid_getTile(const TileGrid *grid, int i);
+
+void TileGrid_free(TileGrid *grid);
+
+#endif //TILES_H
@@ -0,0 +1,73 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include<stdbool.h>
+#include<stdatomic.h>
+
+/** Maximum number of events of a trace, later events are dropped. */
+#define TRACE_DEFAULT_CAPACITY (1 << 20)
+
+/** Thread id of the events of the thread running the frames (the caller of Renderer_render). */
+#define TRACE_THREAD_RENDER 1000
+/** Thread id of the presentation events of the window front-end, on its main thread. */
+#define TRACE_THREAD_PRESENTER 1001
+
+/**
+ * Timeline of the activity of the threads, written as Chrome trace-event JSON
+ * (chrome://tracing, https://ui.perfetto.dev).
+ *
+ * Events are appended to a single preallocated buffer from any thread. The workers of the pool use their
+ * index as thread id. While no trace is recording, recording an event costs a relaxed load.
+ */
+typedef struct{
+	const char *name;
+	/** 'X' for an event with a duration, 'i' for an instant. */
+	char phase;
+	int thread;
+	/** In milliseconds, on the clock of GetTimeMs. */
+	double start;
+	double duration;
+	/** Optional argument, ignored if argName is NULL. */
+	const char *argName;
+	int arg;
+}TraceEvent;
+
+extern atomic_bool traceEnabled;
+
+static inline bool Trace_enabled(){
+	return atomic_load_explicit(&traceEnabled, memory_order_relaxed);
+}
+
+/**
+ * @brief Starts recording a trace, discarding the previous one.
+ *
+ * @param capacity Maximum number of events, TRACE_DEFAULT_CAPACITY if not positive.
+ * @return 0 in case of success, -1 if allocation fails.
+ */
+int Trace_begin(int capacity);
+
+/**
+ * @brief Stops recording and writes the trace to a JSON file.
+ *
+ * Must be called once no thread records events any more.
+ *
+ * @return 0 in case of success, -1 if no trace was recording or the file cannot be written.
+ */
+int Trace_end(const char *path);
+
+/**
+ * @brief Records an event lasting from start to end, in milliseconds on the clock of GetTimeMs.
+ */
+void Trace_complete(const char *name, int thread, double start, double end, const char *argName, int arg);
+
+/**
+ * @brief Records an instant event at the current time.
+ */
+void Trace_instant(const char *name, int thread, const char *argName, int arg);
+
+/**
+ * @brief Names a thread in the timeline.
+ */
+void Trace_nameThread(int thread, const char *name);
+
+#endif //TRACE_H
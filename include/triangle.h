@@ -3,23 +3,30 @@
 
 #include"geometry.h"
 #include<stddef.h>
+#include<stdbool.h>
 
+/**
+ * A triangle fetched from the indexed storage of a Model.
+ *
+ * Triangles are not stored as such: a Model keeps a shared vertex array and an index buffer,
+ * and builds a Triangle by value when one is needed (see Model_getTriangle).
+ */
 typedef struct{
-	Point *a, *b, *c;
+	Point a, b, c;
 	/** Index of the material */
-	unsigned char material;
+	unsigned short material;
 }Triangle;
 
 /**
- * @brief Allocates and initializes a new Triangle structure.
- * 
- * @param a Pointer to the first vertex of the triangle.
- * @param b Pointer to the second vertex of the triangle.
- * @param c Pointer to the third vertex of the triangle.
+ * @brief Creates a new Triangle from three vertices.
+ *
+ * @param a The first vertex of the triangle.
+ * @param b The second vertex of the triangle.
+ * @param c The third vertex of the triangle.
  * @param material Material identifier for the triangle.
- * @return Pointer to the newly created Triangle structure, or NULL if allocation fails.
+ * @return The Triangle.
  */
-Triangle *Triangle_init(Point *a, Point *b, Point *c, unsigned char material);
+Triangle Triangle_new(Point a, Point b, Point c, unsigned short material);
 
 /**
  * Computes and returns the normal vector of a triangle.
@@ -29,31 +36,34 @@ Triangle *Triangle_init(Point *a, Point *b, Point *c, unsigned char material);
  * @param t Pointer to the Triangle.
  * @return The normal Vector of the triangle.
  */
-Vector Triangle_getNormal(Triangle *t);
+Vector Triangle_getNormal(const Triangle *t);
 
 /**
- * @brief Translates the triangle by a given vector.
- * 
- * @param t Pointer to the Triangle to be translated.
- * @param translation The vector by which to translate the triangle.
+ * @brief Computes the intersection between a ray and a triangle (Möller–Trumbore).
+ *
+ * @param t Pointer to the Triangle.
+ * @param ray Pointer to the ray, its direction must be normalized.
+ * @param distance Output, distance from the ray origin to the intersection point.
+ *
+ * @return true if the ray hits the triangle in front of its origin, false otherwise.
  */
-void Triangle_translate(Triangle *t, Vector translation);
+bool Triangle_intersect(const Triangle *t, Line *ray, float *distance);
 
 /**
  * @brief Computes the centroid (center point) of the triangle.
- * 
+ *
  * @param t Pointer to the Triangle.
- * @return Pointer to a the Point representing the centroid of the triangle.
+ * @return The Point representing the centroid of the triangle.
  */
-Point *Triangle_center(Triangle *t);
+Point Triangle_center(const Triangle *t);
 
 /**
- * @brief Computes the memory size occupied by the Triangle structure and its components.
- * 
+ * @brief Computes the memory size occupied by the Triangle structure.
+ *
  * @param t Pointer to the Triangle.
- * 
- * @return Size in bytes of the Triangle structure and its components.
+ *
+ * @return Size in bytes of the Triangle structure.
  */
-size_t Triangle_size(Triangle *t);
+size_t Triangle_size(const Triangle *t);
 
-#endif
\ No newline at end of file
+#endif
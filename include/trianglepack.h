@@ -0,0 +1,68 @@
+#ifndef TRIANGLEPACK_H
+#define TRIANGLEPACK_H
+
+#include<stdbool.h>
+#include<stddef.h>
+#include"geometry.h"
+#include"triangle.h"
+
+/**
+ * Triangles of a mesh packed for SIMD intersection tests.
+ *
+ * Every coordinate of the first vertex and of the two edges leaving it has its own array (structure of arrays),
+ * so a kernel loads the same coordinate of consecutive triangles with one instruction. Models store their triangles
+ * in the order of their BVH primitives, a leaf of the BVH is then a contiguous range of the pack.
+ *
+ * The kernel follows the SIMD level (see simd.h): AVX2 tests 8 triangles at a time, SSE4.1 tests 4 and the scalar
+ * kernel tests one. Every kernel performs the operations of Triangle_intersect in the same order, so they all
+ * report the same hits at the same distances.
+ */
+
+/** Number of triangles tested at once by the widest kernel, also the padding at the end of the arrays. */
+#define TRIANGLE_PACK_WIDTH 8
+
+typedef struct{
+	/** Coordinates x, y, z of the first vertex of every triangle. */
+	float *v0[3];
+	/** Coordinates of the edge from the first to the second vertex. */
+	float *e1[3];
+	/** Coordinates of the edge from the first to the third vertex. */
+	float *e2[3];
+	/** Number of triangles. */
+	int count;
+}TrianglePack;
+
+/**
+ * @brief Allocates a pack of count triangles, selecting the SIMD level if none has been selected yet.
+ *
+ * @return Pointer to the pack, or NULL if count is 0 or allocation fails.
+ */
+TrianglePack *TrianglePack_new(int count);
+
+/**
+ * @brief Stores a triangle at position i of the pack.
+ */
+void TrianglePack_set(TrianglePack *pack, int i, const Triangle *t);
+
+/**
+ * @brief Finds the closest triangle of a range of the pack hit by a ray.
+ *
+ * @param first Position of the first triangle of the range.
+ * @param count Number of triangles of the range.
+ * @param ray Pointer to the ray, its direction must be normalized.
+ * @param tMax In: distance of the closest hit found so far. Out: updated if a closer hit is found.
+ *
+ * @return Position in the pack of the closest triangle hit before tMax, -1 if none.
+ */
+int TrianglePack_intersect(const TrianglePack *pack, int first, int count, Line *ray, float *tMax);
+
+/**
+ * @brief Returns true if the ray hits any triangle of a range of the pack at a distance in (tMin, tMax).
+ */
+bool TrianglePack_occluded(const TrianglePack *pack, int first, int count, Line *ray, float tMin, float tMax);
+
+size_t TrianglePack_size(const TrianglePack *pack);
+
+void TrianglePack_free(TrianglePack *pack);
+
+#endif //TRIANGLEPACK_H
@@ -23,5 +23,9 @@ char* GetFullPath(char *fileName);
  */
 char *GetDirectoryPath(char *fullPath);
 
+/**
+ * @brief Returns the time of a monotonic clock in milliseconds, from an arbitrary origin, for measuring durations.
+ */
+double GetTimeMs();
 
 #endif //UTILS_H
\ No newline at end of file
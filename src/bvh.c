@@ -0,0 +1,506 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include"bvh.h"
+#include"stats.h"
+
+#define BVH_TRAVERSAL_COST 1.0f
+#define BVH_INTERSECTION_COST 1.0f
+
+AABB AABB_empty(){
+	AABB box;
+	box.min = (Point){INFINITY, INFINITY, INFINITY};
+	box.max = (Point){-INFINITY, -INFINITY, -INFINITY};
+	return box;
+}
+
+AABB AABB_fromPoint(Point p){
+	AABB box;
+	box.min = p;
+	box.max = p;
+	return box;
+}
+
+AABB AABB_union(AABB a, AABB b){
+	AABB box;
+	box.min = (Point){fminf(a.min.x, b.min.x), fminf(a.min.y, b.min.y), fminf(a.min.z, b.min.z)};
+	box.max = (Point){fmaxf(a.max.x, b.max.x), fmaxf(a.max.y, b.max.y), fmaxf(a.max.z, b.max.z)};
+	return box;
+}
+
+AABB AABB_extend(AABB box, Point p){
+	return AABB_union(box, AABB_fromPoint(p));
+}
+
+Point AABB_centroid(AABB box){
+	return (Point){(box.min.x + box.max.x) / 2, (box.min.y + box.max.y) / 2, (box.min.z + box.max.z) / 2};
+}
+
+float AABB_surfaceArea(AABB box){
+	float dx = box.max.x - box.min.x;
+	float dy = box.max.y - box.min.y;
+	float dz = box.max.z - box.min.z;
+	if(dx < 0 || dy < 0 || dz < 0) return 0;
+	return 2 * (dx*dy + dy*dz + dz*dx);
+}
+
+// plain comparisons compile to single min/max instructions, fminf/fmaxf do not because of their NaN rules
+static inline float MinF(float a, float b){
+	return a < b ? a : b;
+}
+
+static inline float MaxF(float a, float b){
+	return a > b ? a : b;
+}
+
+float AABB_intersect(const AABB *box, const Point *origin, Vector inverseDirection, float tMax){
+	float tx1 = (box->min.x - origin->x) * inverseDirection.x;
+	float tx2 = (box->max.x - origin->x) * inverseDirection.x;
+	float tNear = MinF(tx1, tx2);
+	float tFar = MaxF(tx1, tx2);
+
+	float ty1 = (box->min.y - origin->y) * inverseDirection.y;
+	float ty2 = (box->max.y - origin->y) * inverseDirection.y;
+	tNear = MaxF(tNear, MinF(ty1, ty2));
+	tFar = MinF(tFar, MaxF(ty1, ty2));
+
+	float tz1 = (box->min.z - origin->z) * inverseDirection.z;
+	float tz2 = (box->max.z - origin->z) * inverseDirection.z;
+	tNear = MaxF(tNear, MinF(tz1, tz2));
+	tFar = MinF(tFar, MaxF(tz1, tz2));
+
+	if(tFar < tNear || tFar < 0 || tNear > tMax) return INFINITY;
+	return tNear;
+}
+
+
+typedef struct{
+	AABB bounds;
+	int count;
+}Bin;
+
+typedef struct{
+	const AABB *bounds;
+	Point *centroids;
+	BVH *bvh;
+	int maxLeafSize;
+}BuildContext;
+
+static float CentroidAxis(Point p, int axis){
+	return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+static void UpdateNodeBounds(BuildContext *ctx, BVHNode *node){
+	node->bounds = AABB_empty();
+	for(int i = 0; i < node->count; i++){
+		int prim = ctx->bvh->primitives[node->leftFirst + i];
+		node->bounds = AABB_union(node->bounds, ctx->bounds[prim]);
+	}
+}
+
+/**
+ * Evaluates the binned SAH along every axis and returns the cost of the best split.
+ * The chosen axis and split position are written to axisOut and positionOut.
+ */
+static float FindBestSplit(BuildContext *ctx, BVHNode *node, int *axisOut, float *positionOut){
+	float bestCost = INFINITY;
+	AABB centroidBounds = AABB_empty();
+	for(int i = 0; i < node->count; i++){
+		centroidBounds = AABB_extend(centroidBounds, ctx->centroids[ctx->bvh->primitives[node->leftFirst + i]]);
+	}
+
+	for(int axis = 0; axis < 3; axis++){
+		float boundsMin = CentroidAxis(centroidBounds.min, axis);
+		float boundsMax = CentroidAxis(centroidBounds.max, axis);
+		if(boundsMin == boundsMax) continue;
+
+		Bin bins[BVH_NUM_BINS];
+		for(int b = 0; b < BVH_NUM_BINS; b++){
+			bins[b].bounds = AABB_empty();
+			bins[b].count = 0;
+		}
+		float scale = BVH_NUM_BINS / (boundsMax - boundsMin);
+		for(int i = 0; i < node->count; i++){
+			int prim = ctx->bvh->primitives[node->leftFirst + i];
+			int b = (int)((CentroidAxis(ctx->centroids[prim], axis) - boundsMin) * scale);
+			if(b > BVH_NUM_BINS - 1) b = BVH_NUM_BINS - 1;
+			bins[b].count++;
+			bins[b].bounds = AABB_union(bins[b].bounds, ctx->bounds[prim]);
+		}
+
+		// sweep from both sides to get the cost of every plane between two bins
+		float leftArea[BVH_NUM_BINS - 1], rightArea[BVH_NUM_BINS - 1];
+		int leftCount[BVH_NUM_BINS - 1], rightCount[BVH_NUM_BINS - 1];
+		AABB leftBox = AABB_empty(), rightBox = AABB_empty();
+		int leftSum = 0, rightSum = 0;
+		for(int b = 0; b < BVH_NUM_BINS - 1; b++){
+			leftSum += bins[b].count;
+			leftCount[b] = leftSum;
+			leftBox = AABB_union(leftBox, bins[b].bounds);
+			leftArea[b] = AABB_surfaceArea(leftBox);
+
+			rightSum += bins[BVH_NUM_BINS - 1 - b].count;
+			rightCount[BVH_NUM_BINS - 2 - b] = rightSum;
+			rightBox = AABB_union(rightBox, bins[BVH_NUM_BINS - 1 - b].bounds);
+			rightArea[BVH_NUM_BINS - 2 - b] = AABB_surfaceArea(rightBox);
+		}
+
+		float binWidth = (boundsMax - boundsMin) / BVH_NUM_BINS;
+		for(int b = 0; b < BVH_NUM_BINS - 1; b++){
+			if(leftCount[b] == 0 || rightCount[b] == 0) continue;
+			float cost = leftCount[b] * leftArea[b] + rightCount[b] * rightArea[b];
+			if(cost < bestCost){
+				bestCost = cost;
+				*axisOut = axis;
+				*positionOut = boundsMin + binWidth * (b + 1);
+			}
+		}
+	}
+
+	float parentArea = AABB_surfaceArea(node->bounds);
+	if(parentArea <= 0) return INFINITY;
+	return BVH_TRAVERSAL_COST + BVH_INTERSECTION_COST * bestCost / parentArea;
+}
+
+static void Subdivide(BuildContext *ctx, int nodeIndex, int depth){
+	BVH *bvh = ctx->bvh;
+	BVHNode *node = &bvh->nodes[nodeIndex];
+	if(node->count <= 1 || depth >= BVH_MAX_DEPTH - 1) return;
+
+	int axis = 0;
+	float splitPosition = 0;
+	float splitCost = FindBestSplit(ctx, node, &axis, &splitPosition);
+	float leafCost = BVH_INTERSECTION_COST * node->count;
+	if(splitCost >= leafCost && node->count <= ctx->maxLeafSize) return;
+	if(splitCost == INFINITY) return; // all centroids coincide, nothing to split
+
+	// in-place partition of the primitive range
+	int i = node->leftFirst;
+	int j = i + node->count - 1;
+	while(i <= j){
+		if(CentroidAxis(ctx->centroids[bvh->primitives[i]], axis) < splitPosition){
+			i++;
+		}
+		else{
+			int tmp = bvh->primitives[i];
+			bvh->primitives[i] = bvh->primitives[j];
+			bvh->primitives[j--] = tmp;
+		}
+	}
+	int leftCount = i - node->leftFirst;
+	if(leftCount == 0 || leftCount == node->count) return;
+
+	int leftIndex = bvh->numNodes;
+	bvh->numNodes += 2;
+	BVHNode *left = &bvh->nodes[leftIndex];
+	BVHNode *right = &bvh->nodes[leftIndex + 1];
+	left->leftFirst = node->leftFirst;
+	left->count = leftCount;
+	right->leftFirst = i;
+	right->count = node->count - leftCount;
+	node->leftFirst = leftIndex;
+	node->count = 0;
+
+	UpdateNodeBounds(ctx, left);
+	UpdateNodeBounds(ctx, right);
+	Subdivide(ctx, leftIndex, depth + 1);
+	Subdivide(ctx, leftIndex + 1, depth + 1);
+}
+
+BVH *BVH_build(const AABB *bounds, int numPrimitives, int maxLeafSize){
+	if(bounds == NULL || numPrimitives <= 0) return NULL;
+
+	BVH *bvh = malloc(sizeof(BVH));
+	if(bvh == NULL){
+		printf("ERROR::BVH::BVH_build::Failed to allocate memory for BVH\n");
+		return NULL;
+	}
+	bvh->nodes = malloc((2 * numPrimitives - 1) * sizeof(BVHNode));
+	bvh->primitives = malloc(numPrimitives * sizeof(int));
+	Point *centroids = malloc(numPrimitives * sizeof(Point));
+	if(bvh->nodes == NULL || bvh->primitives == NULL || centroids == NULL){
+		printf("ERROR::BVH::BVH_build::Failed to allocate memory for BVH arrays\n");
+		free(bvh->nodes);
+		free(bvh->primitives);
+		free(centroids);
+		free(bvh);
+		return NULL;
+	}
+	for(int i = 0; i < numPrimitives; i++){
+		bvh->primitives[i] = i;
+		centroids[i] = AABB_centroid(bounds[i]);
+	}
+	bvh->numPrimitives = numPrimitives;
+	bvh->numNodes = 1;
+
+	BuildContext ctx;
+	ctx.bounds = bounds;
+	ctx.centroids = centroids;
+	ctx.bvh = bvh;
+	ctx.maxLeafSize = maxLeafSize < 1 ? 1 : maxLeafSize;
+
+	BVHNode *root = &bvh->nodes[0];
+	root->leftFirst = 0;
+	root->count = numPrimitives;
+	UpdateNodeBounds(&ctx, root);
+	Subdivide(&ctx, 0, 0);
+
+	free(centroids);
+	return bvh;
+}
+
+bool BVH_intersect(const BVH *bvh, Line *ray, float *tMax, BVHLeafTest test, void *context){
+	if(bvh == NULL) return false;
+	Vector inverseDirection = {1 / ray->direction.x, 1 / ray->direction.y, 1 / ray->direction.z, 0};
+	const Point *origin = &ray->origin;
+
+	if(AABB_intersect(&bvh->nodes[0].bounds, origin, inverseDirection, *tMax) == INFINITY){
+		STATS_INCREMENT(STAT_BOUNDS_REJECTS);
+		return false;
+	}
+
+	// every pushed node keeps its entry distance, so it can be skipped if a closer hit is found meanwhile
+	const BVHNode *stack[BVH_MAX_DEPTH];
+	float stackDistance[BVH_MAX_DEPTH];
+	int stackSize = 0;
+	const BVHNode *node = &bvh->nodes[0];
+	bool hit = false;
+	while(1){
+		if(node->count > 0){
+			if(test(context, bvh->primitives + node->leftFirst, node->count, ray, tMax)) hit = true;
+		}
+		else{
+			const BVHNode *near = &bvh->nodes[node->leftFirst];
+			const BVHNode *far = near + 1;
+			float tNear = AABB_intersect(&near->bounds, origin, inverseDirection, *tMax);
+			float tFar = AABB_intersect(&far->bounds, origin, inverseDirection, *tMax);
+			if(tFar < tNear){
+				const BVHNode *tmpNode = near; near = far; far = tmpNode;
+				float tmp = tNear; tNear = tFar; tFar = tmp;
+			}
+			if(tNear != INFINITY){
+				if(tFar != INFINITY){
+					stack[stackSize] = far;
+					stackDistance[stackSize++] = tFar;
+				}
+				node = near;
+				continue;
+			}
+		}
+
+		// pop the next subtree that can still contain a closer hit
+		node = NULL;
+		while(stackSize > 0){
+			stackSize--;
+			if(stackDistance[stackSize] <= *tMax){
+				node = stack[stackSize];
+				break;
+			}
+		}
+		if(node == NULL) break;
+	}
+	return hit;
+}
+
+/**
+ * Tests a box against the active rays of a packet, computing for every ray what AABB_intersect computes.
+ * The loop has no branch, so that it compiles to SIMD instructions.
+ *
+ * @return Mask of the rays entering the box within [0, tMax].
+ */
+static uint32_t PacketIntersectBox(const AABB *box, const RayPacket *packet, uint32_t active){
+	float minX = box->min.x - packet->origin.x, maxX = box->max.x - packet->origin.x;
+	float minY = box->min.y - packet->origin.y, maxY = box->max.y - packet->origin.y;
+	float minZ = box->min.z - packet->origin.z, maxZ = box->max.z - packet->origin.z;
+	int hits[PACKET_SIZE];
+	for(int i = 0; i < PACKET_SIZE; i++){
+		float tx1 = minX * packet->inverse[0][i];
+		float tx2 = maxX * packet->inverse[0][i];
+		float tNear = MinF(tx1, tx2);
+		float tFar = MaxF(tx1, tx2);
+
+		float ty1 = minY * packet->inverse[1][i];
+		float ty2 = maxY * packet->inverse[1][i];
+		tNear = MaxF(tNear, MinF(ty1, ty2));
+		tFar = MinF(tFar, MaxF(ty1, ty2));
+
+		float tz1 = minZ * packet->inverse[2][i];
+		float tz2 = maxZ * packet->inverse[2][i];
+		tNear = MaxF(tNear, MinF(tz1, tz2));
+		tFar = MinF(tFar, MaxF(tz1, tz2));
+
+		hits[i] = !(tFar < tNear || tFar < 0 || tNear > packet->tMax[i]);
+	}
+	uint32_t mask = 0;
+	for(int i = 0; i < PACKET_SIZE; i++) mask |= (uint32_t)hits[i] << i;
+	return mask & active;
+}
+
+/**
+ * Returns true if a box lies entirely outside one of the planes of the frustum of a packet.
+ */
+static bool PacketMissesBox(const AABB *box, const RayPacket *packet){
+	for(int k = 0; k < 4; k++){
+		Vector n = packet->frustum[k];
+		// the corner of the box farthest along the normal
+		float x = (n.x >= 0 ? box->max.x : box->min.x) - packet->origin.x;
+		float y = (n.y >= 0 ? box->max.y : box->min.y) - packet->origin.y;
+		float z = (n.z >= 0 ? box->max.z : box->min.z) - packet->origin.z;
+		if(n.x*x + n.y*y + n.z*z < 0) return true;
+	}
+	return false;
+}
+
+/**
+ * Traverses a subtree with a single ray of a packet, the box of the subtree root must already have been tested.
+ */
+static uint32_t IntersectPacketRay(const BVH *bvh, const BVHNode *root, RayPacket *packet, int lane, BVHPacketLeafTest test, void *context){
+	Vector inverseDirection = {packet->inverse[0][lane], packet->inverse[1][lane], packet->inverse[2][lane], 0};
+	const Point *origin = &packet->origin;
+	float *tMax = &packet->tMax[lane];
+	uint32_t ray = 1u << lane;
+
+	const BVHNode *stack[BVH_MAX_DEPTH];
+	float stackDistance[BVH_MAX_DEPTH];
+	int stackSize = 0;
+	const BVHNode *node = root;
+	uint32_t hit = 0;
+	while(1){
+		if(node->count > 0){
+			hit |= test(context, bvh->primitives + node->leftFirst, node->count, packet, ray);
+		}
+		else{
+			const BVHNode *near = &bvh->nodes[node->leftFirst];
+			const BVHNode *far = near + 1;
+			float tNear = AABB_intersect(&near->bounds, origin, inverseDirection, *tMax);
+			float tFar = AABB_intersect(&far->bounds, origin, inverseDirection, *tMax);
+			if(tFar < tNear){
+				const BVHNode *tmpNode = near; near = far; far = tmpNode;
+				float tmp = tNear; tNear = tFar; tFar = tmp;
+			}
+			if(tNear != INFINITY){
+				if(tFar != INFINITY){
+					stack[stackSize] = far;
+					stackDistance[stackSize++] = tFar;
+				}
+				node = near;
+				continue;
+			}
+		}
+
+		node = NULL;
+		while(stackSize > 0){
+			stackSize--;
+			if(stackDistance[stackSize] <= *tMax){
+				node = stack[stackSize];
+				break;
+			}
+		}
+		if(node == NULL) break;
+	}
+	return hit;
+}
+
+uint32_t BVH_intersectPacket(const BVH *bvh, RayPacket *packet, uint32_t active, BVHPacketLeafTest test, void *context){
+	if(bvh == NULL || active == 0) return 0;
+
+	// the rays left in a subtree are pushed with it, and tested again against its box when it is popped
+	const BVHNode *stack[BVH_MAX_DEPTH];
+	uint32_t stackActive[BVH_MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize] = &bvh->nodes[0];
+	stackActive[stackSize++] = active;
+	uint32_t hit = 0;
+	while(stackSize > 0){
+		stackSize--;
+		const BVHNode *node = stack[stackSize];
+		uint32_t rays = stackActive[stackSize];
+		rays = PacketMissesBox(&node->bounds, packet) ? 0 : PacketIntersectBox(&node->bounds, packet, rays);
+		if(node == &bvh->nodes[0]) STATS_ADD(STAT_BOUNDS_REJECTS, RayPacket_count(active & ~rays));
+		if(rays == 0) continue;
+
+		if(RayPacket_count(rays) < PACKET_MIN_ACTIVE){
+			for(int i = 0; i < PACKET_SIZE; i++){
+				if(rays & (1u << i)) hit |= IntersectPacketRay(bvh, node, packet, i, test, context);
+			}
+			continue;
+		}
+		if(node->count > 0){
+			hit |= test(context, bvh->primitives + node->leftFirst, node->count, packet, rays);
+			continue;
+		}
+
+		// the child the rays reach first is visited first, judging from the first ray along the axis separating the children
+		const BVHNode *near = &bvh->nodes[node->leftFirst];
+		const BVHNode *far = near + 1;
+		Point nearCenter = AABB_centroid(near->bounds);
+		Point farCenter = AABB_centroid(far->bounds);
+		float separation[3] = {farCenter.x - nearCenter.x, farCenter.y - nearCenter.y, farCenter.z - nearCenter.z};
+		int axis = 0;
+		for(int a = 1; a < 3; a++){
+			if(fabsf(separation[a]) > fabsf(separation[axis])) axis = a;
+		}
+		int first = 0;
+		while(!(rays & (1u << first))) first++;
+		if(separation[axis] * packet->inverse[axis][first] < 0){
+			const BVHNode *tmp = near; near = far; far = tmp;
+		}
+		stack[stackSize] = far;
+		stackActive[stackSize++] = rays;
+		stack[stackSize] = near;
+		stackActive[stackSize++] = rays;
+	}
+	return hit;
+}
+
+bool BVH_occluded(const BVH *bvh, Line *ray, float tMax, BVHLeafTest test, void *context){
+	if(bvh == NULL) return false;
+	Vector inverseDirection = {1 / ray->direction.x, 1 / ray->direction.y, 1 / ray->direction.z, 0};
+	const Point *origin = &ray->origin;
+
+	// any order is fine here, so children are simply pushed without being sorted
+	const BVHNode *stack[BVH_MAX_DEPTH];
+	int stackSize = 0;
+	stack[stackSize++] = &bvh->nodes[0];
+	while(stackSize > 0){
+		const BVHNode *node = stack[--stackSize];
+		if(AABB_intersect(&node->bounds, origin, inverseDirection, tMax) == INFINITY) continue;
+		if(node->count > 0){
+			float t = tMax;
+			if(test(context, bvh->primitives + node->leftFirst, node->count, ray, &t)) return true;
+			continue;
+		}
+		stack[stackSize++] = &bvh->nodes[node->leftFirst + 1];
+		stack[stackSize++] = &bvh->nodes[node->leftFirst];
+	}
+	return false;
+}
+
+void BVH_translate(BVH *bvh, Vector translation){
+	if(bvh == NULL) return;
+	for(int i = 0; i < bvh->numNodes; i++){
+		AABB *box = &bvh->nodes[i].bounds;
+		box->min = (Point){box->min.x + translation.x, box->min.y + translation.y, box->min.z + translation.z};
+		box->max = (Point){box->max.x + translation.x, box->max.y + translation.y, box->max.z + translation.z};
+	}
+}
+
+AABB BVH_bounds(const BVH *bvh){
+	if(bvh == NULL) return AABB_empty();
+	return bvh->nodes[0].bounds;
+}
+
+void BVH_free(BVH *bvh){
+	if(bvh == NULL) return;
+	free(bvh->nodes);
+	free(bvh->primitives);
+	free(bvh);
+}
+
+size_t BVH_size(const BVH *bvh){
+	if(bvh == NULL) return 0;
+	size_t size = sizeof(*bvh);
+	size += bvh->numNodes * sizeof(*bvh->nodes);
+	size += bvh->numPrimitives * sizeof(*bvh->primitives);
+	return size;
+}
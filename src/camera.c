@@ -29,22 +29,22 @@ Camera* Camera_new(Point *position, Vector front, Vector up, float fov){
 
 void Camera_ProcessMovement(Camera *camera, CameraMovement movement){
       if(movement == CAMERA_MOVEMENT_FORWARD){
-            camera->position = Point_translate(camera->position, Vector_scale(camera->front, moveStep));
+            *camera->position = Point_translate(camera->position, Vector_scale(camera->front, moveStep));
       }
       else if(movement == CAMERA_MOVEMENT_BACKWARD){
-            camera->position = Point_translate(camera->position, Vector_scale(camera->front, -moveStep));
+            *camera->position = Point_translate(camera->position, Vector_scale(camera->front, -moveStep));
       }
       else if(movement == CAMERA_MOVEMENT_RIGHT){
-            camera->position = Point_translate(camera->position, Vector_scale(camera->right, moveStep));
+            *camera->position = Point_translate(camera->position, Vector_scale(camera->right, moveStep));
       }
       else if(movement == CAMERA_MOVEMENT_LEFT){
-            camera->position = Point_translate(camera->position, Vector_scale(camera->right, -moveStep));
+            *camera->position = Point_translate(camera->position, Vector_scale(camera->right, -moveStep));
       }
       else if(movement == CAMERA_MOVEMENT_UP){
-            camera->position = Point_translate(camera->position, Vector_scale(camera->up, moveStep));
+            *camera->position = Point_translate(camera->position, Vector_scale(camera->up, moveStep));
       }
       else if(movement == CAMERA_MOVEMENT_DOWN){
-            camera->position = Point_translate(camera->position, Vector_scale(camera->up, -moveStep));
+            *camera->position = Point_translate(camera->position, Vector_scale(camera->up, -moveStep));
       }
       else if(movement == CAMERA_MOVEMENT_ROTATE_RIGHT){
             camera->front = Vector_rotate(camera->front, camera->up, angleStep);
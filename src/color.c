@@ -130,6 +130,15 @@ Color Color_multiply(Color c1, Color c2){
 	return result;
 }
 
+int Color_difference(Color c1, Color c2){
+	int difference = 0;
+	for(int shift = 0; shift <= 16; shift += 8){
+		int channel = abs((int)((c1.color >> shift) & 0xFF) - (int)((c2.color >> shift) & 0xFF));
+		if(channel > difference) difference = channel;
+	}
+	return difference;
+}
+
 int Color_size(Color color){
 	return sizeof(color.color);
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include"demoscene.h"
+#include"objloader.h"
+
+Scene *CreateScene(int numObj, char **objs){
+	float fov = 90 * M_PI / 180;
+	Camera *camera = Camera_new(Point_init(0, 0, 20), Vector_init(0, 0, -1), Vector_init(0, 1, 0), fov);
+	Scene *scene = Scene_init(camera);
+
+	Material mat;
+	
+	
+	float floorY = -10;
+	mat.diffuse = COLOR_BLUE;
+	mat.specular = COLOR_BLACK;
+	mat.reflexivity = 0;
+	mat.specularExponent = 0;
+	mat.ambient = 0.05;
+	Model *floor = Model_createRectXZ(Point_init(-500, floorY, -500), 1000, 1000, mat);
+
+	int numSphere = 8;
+	Model **spheres = malloc(numSphere * sizeof(Model*));
+	if(spheres == NULL){
+		printf("ERROR::DEMOSCENE::CreateScene::Failed to allocate memory for spheres array\n");
+		return scene;
+	}
+
+	float radius = 10;
+	mat.diffuse = COLOR_GREEN;
+	mat.specular = Color_fromRGB(0.5, 0.5, 0.5);
+	mat.specularExponent = 32;
+	mat.ambient = 0.05;
+	mat.reflexivity = 1;
+	spheres[0] = Model_createSphere(Point_init(10, floorY+radius, -20), radius, mat);
+
+	radius = 3;
+	mat.diffuse = COLOR_RED;
+	mat.reflexivity = 0;
+	spheres[1] = Model_createSphere(Point_init(-5, floorY+radius, -10), radius, mat);
+
+	radius = 1;
+	mat.diffuse = COLOR_YELLOW;
+	mat.reflexivity = 0;
+	spheres[2] = Model_createSphere(Point_init(10, floorY+radius, -10), radius, mat);
+
+	radius = 2;
+	mat.diffuse = COLOR_GREEN;
+	mat.reflexivity = 0;
+	spheres[3] = Model_createSphere(Point_init(5, floorY+radius, -12), radius, mat);
+	
+	radius = 4;
+	mat.diffuse = COLOR_ORANGE;
+	mat.reflexivity = 0;
+	spheres[4] = Model_createSphere(Point_init(20, floorY+radius, -12), radius, mat);
+
+	radius = 15;
+	mat.diffuse = COLOR_YELLOW;
+	mat.reflexivity = 0.2;
+	spheres[5] = Model_createSphere(Point_init(-20, floorY+radius, -30), radius, mat);
+	
+	radius = 1.5;
+	mat.diffuse = COLOR_CYAN;
+	mat.reflexivity = 0;
+	spheres[6] = Model_createSphere(Point_init(5, floorY+radius, -2), radius, mat);
+	
+	radius = 1.5;
+	mat.diffuse = COLOR_MAGENTA;
+	mat.reflexivity = 0;
+	spheres[7] = Model_createSphere(Point_init(-10, floorY+radius, 0), radius, mat);
+
+	Light *lightSource = Light_new(Point_init(15, 10, -1), 2, COLOR_WHITE);
+	Light_setAttenuation(lightSource, 1, 0.0000, 0.0000);
+	Scene_fill(scene, lightSource, &floor, 1);
+	Scene_addModels(scene, spheres, numSphere);
+
+	if(numObj <= 0) return scene;
+
+	Model **objects = malloc(numObj * sizeof(Model*));
+	if(objects == NULL){
+		printf("ERROR::DEMOSCENE::CreateScene::Failed to allocate memory for objects array\n");
+		return scene;
+	}
+	// files that fail to load are left out of the scene, Model_fromOBJ reports why
+	int numLoaded = 0;
+	for(int i = 0; i < numObj; i++){
+		Model *object = Model_fromOBJ(objs[i]);
+		if(object == NULL) continue;
+		Vector translation = Vector_init(0, floorY - object->center->y + object->boundingRadius, 0);
+		Model_translate(object, translation);
+		objects[numLoaded++] = object;
+	}
+
+	Scene_addModels(scene, objects, numLoaded);
+
+	printf("Scene size is %zu bytes\n", Scene_size(scene));
+
+	return scene;
+}
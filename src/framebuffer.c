@@ -0,0 +1,85 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include"framebuffer.h"
+
+static int AllocateBuffers(Framebuffer *framebuffer, int width, int height){
+	for(int i = 0; i < 3; i++){
+		framebuffer->buffers[i] = calloc((size_t)width * height, sizeof(uint32_t));
+		if(framebuffer->buffers[i] == NULL){
+			for(int j = 0; j < i; j++){
+				free(framebuffer->buffers[j]);
+				framebuffer->buffers[j] = NULL;
+			}
+			framebuffer->width = 0;
+			framebuffer->height = 0;
+			return -1;
+		}
+	}
+	framebuffer->width = width;
+	framebuffer->height = height;
+	framebuffer->back = 0;
+	framebuffer->front = 1;
+	atomic_store(&framebuffer->ready, 2);
+	return 0;
+}
+
+Framebuffer *Framebuffer_new(int width, int height){
+	Framebuffer *framebuffer = malloc(sizeof(Framebuffer));
+	if(framebuffer == NULL){
+		printf("ERROR::FRAMEBUFFER::Framebuffer_new::Failed to allocate memory for Framebuffer\n");
+		return NULL;
+	}
+	atomic_init(&framebuffer->ready, 2);
+	if(AllocateBuffers(framebuffer, width, height) != 0){
+		printf("ERROR::FRAMEBUFFER::Framebuffer_new::Failed to allocate memory for buffers\n");
+		free(framebuffer);
+		return NULL;
+	}
+	pthread_mutex_init(&framebuffer->mutex, NULL);
+	return framebuffer;
+}
+
+int Framebuffer_resize(Framebuffer *framebuffer, int width, int height){
+	if(framebuffer->width == width && framebuffer->height == height) return 0;
+
+	pthread_mutex_lock(&framebuffer->mutex);
+	for(int i = 0; i < 3; i++){
+		free(framebuffer->buffers[i]);
+		framebuffer->buffers[i] = NULL;
+	}
+	int result = AllocateBuffers(framebuffer, width, height);
+	pthread_mutex_unlock(&framebuffer->mutex);
+
+	if(result != 0) printf("ERROR::FRAMEBUFFER::Framebuffer_resize::Failed to allocate memory for buffers\n");
+	return result;
+}
+
+uint32_t *Framebuffer_back(Framebuffer *framebuffer){
+	return framebuffer->buffers[framebuffer->back];
+}
+
+void Framebuffer_publish(Framebuffer *framebuffer){
+	// release: the pixels written by the workers are visible to the presenter acquiring this buffer
+	int spare = atomic_exchange_explicit(&framebuffer->ready, framebuffer->back | FRAMEBUFFER_FRESH, memory_order_acq_rel);
+	framebuffer->back = spare & ~FRAMEBUFFER_FRESH;
+}
+
+bool Framebuffer_acquire(Framebuffer *framebuffer){
+	if(!(atomic_load_explicit(&framebuffer->ready, memory_order_relaxed) & FRAMEBUFFER_FRESH)) return false;
+	int published = atomic_exchange_explicit(&framebuffer->ready, framebuffer->front, memory_order_acq_rel);
+	framebuffer->front = published & ~FRAMEBUFFER_FRESH;
+	return true;
+}
+
+const uint32_t *Framebuffer_front(const Framebuffer *framebuffer){
+	return framebuffer->buffers[framebuffer->front];
+}
+
+void Framebuffer_free(Framebuffer *framebuffer){
+	if(framebuffer == NULL) return;
+	for(int i = 0; i < 3; i++){
+		free(framebuffer->buffers[i]);
+	}
+	pthread_mutex_destroy(&framebuffer->mutex);
+	free(framebuffer);
+}
@@ -12,7 +12,7 @@ Vector Vector_init(float x, float y, float z){
 	return v;
 }
 
-Vector Vector_fromPoints(Point *a, Point *b){
+Vector Vector_fromPoints(const Point *a, const Point *b){
 	return Vector_init(b->x - a->x, b->y - a->y, b->z - a->z);
 }
 
@@ -86,44 +86,51 @@ Point *Point_init(float x, float y, float z){
 	return p;
 }
 
-Point *Point_translate(Point *p, Vector v){
-	return Point_init(p->x + v.x, p->y + v.y, p->z + v.z);
+Point Point_new(float x, float y, float z){
+	Point p;
+	p.x = x;
+	p.y = y;
+	p.z = z;
+	return p;
+}
+
+Point Point_translate(const Point *p, Vector v){
+	return Point_new(p->x + v.x, p->y + v.y, p->z + v.z);
 }
 
 void Point_print(Point *p){
 	printf("(%f, %f, %f)\n", p->x, p->y, p->z);
 }
 
-float Point_distanceSquared(Point *a, Point *b){
-	return pow(a->x - b->x, 2) + pow(a->y - b->y, 2) + pow(a->z - b->z, 2);
+float Point_distanceSquared(const Point *a, const Point *b){
+	float dx = a->x - b->x;
+	float dy = a->y - b->y;
+	float dz = a->z - b->z;
+	return dx*dx + dy*dy + dz*dz;
 }
 
-Line *Line_init(Point *origin, Vector direction){
-	Line *l = malloc(sizeof(Line));
-	if(l == NULL){
-		printf("ERROR::LINE::Line_init::Failed to allocate memory for Line\n");
-		return NULL;
-	}
-	l->origin = origin;
-	l->direction = Vector_normalize(direction);
+Line Line_init(Point origin, Vector direction){
+	Line l;
+	l.origin = origin;
+	l.direction = Vector_normalize(direction);
 	return l;
 }
 
 
-float Line_Point_distance(Line *l, Point *p){
-	Vector p0p1 = Vector_fromPoints(l->origin, p);
+float Line_Point_distance(const Line *l, const Point *p){
+	Vector p0p1 = Vector_fromPoints(&l->origin, p);
 
 	Vector v =  Vector_crossProduct(l->direction, p0p1);
 	Vector n = Vector_crossProduct(l->direction, v);
 
-	float distance = abs(Vector_dot(p0p1, n)) / sqrt(n.normSquared);
+	float distance = fabs(Vector_dot(p0p1, n)) / sqrt(n.normSquared);
 	return distance;
 }
 
-Point *Line_projectionPoint(Line *l, Point *p){
-	Vector v = Vector_fromPoints(l->origin, p);
+Point Line_projectionPoint(const Line *l, const Point *p){
+	Vector v = Vector_fromPoints(&l->origin, p);
 	float scale = Vector_dot(v, l->direction) / l->direction.normSquared;
-	return Point_translate(l->origin, Vector_scale(l->direction, scale));
+	return Point_translate(&l->origin, Vector_scale(l->direction, scale));
 }
 
 int Point_size(Point *p){
@@ -0,0 +1,202 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include"image.h"
+
+/** Largest payload of a stored (uncompressed) deflate block. */
+#define DEFLATE_MAX_STORED 65535
+
+static FILE *OpenFile(const char *path, const char *function){
+	FILE *file = fopen(path, "wb");
+	if(file == NULL){
+		printf("ERROR::IMAGE::%s::Failed to open file %s\n", function, path);
+	}
+	return file;
+}
+
+static void ToRGB(uint32_t pixel, unsigned char *rgb){
+	rgb[0] = (pixel >> 16) & 0xFF;
+	rgb[1] = (pixel >> 8) & 0xFF;
+	rgb[2] = pixel & 0xFF;
+}
+
+int Image_writePPM(const char *path, const uint32_t *pixels, int width, int height){
+	FILE *file = OpenFile(path, "Image_writePPM");
+	if(file == NULL) return -1;
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	unsigned char rgb[3];
+	for(int i = 0; i < width * height; i++){
+		ToRGB(pixels[i], rgb);
+		fwrite(rgb, 1, 3, file);
+	}
+	return fclose(file) == 0 ? 0 : -1;
+}
+
+
+// ───── PNG ─────
+
+typedef struct{
+	FILE *file;
+	uint32_t crc;
+}PNGChunk;
+
+static uint32_t crcTable[256];
+
+static void BuildCRCTable(){
+	for(uint32_t n = 0; n < 256; n++){
+		uint32_t c = n;
+		for(int k = 0; k < 8; k++){
+			c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		}
+		crcTable[n] = c;
+	}
+}
+
+static void WriteBigEndian(FILE *file, uint32_t value){
+	unsigned char bytes[4] = {value >> 24, value >> 16, value >> 8, value};
+	fwrite(bytes, 1, 4, file);
+}
+
+static void PNGChunk_write(PNGChunk *chunk, const unsigned char *data, size_t length){
+	for(size_t i = 0; i < length; i++){
+		chunk->crc = crcTable[(chunk->crc ^ data[i]) & 0xFF] ^ (chunk->crc >> 8);
+	}
+	fwrite(data, 1, length, chunk->file);
+}
+
+static PNGChunk PNGChunk_begin(FILE *file, const char *type, uint32_t length){
+	PNGChunk chunk = {file, 0xFFFFFFFFu};
+	WriteBigEndian(file, length);
+	PNGChunk_write(&chunk, (const unsigned char*)type, 4);
+	return chunk;
+}
+
+static void PNGChunk_end(PNGChunk *chunk){
+	WriteBigEndian(chunk->file, chunk->crc ^ 0xFFFFFFFFu);
+}
+
+int Image_writePNG(const char *path, const uint32_t *pixels, int width, int height){
+	// raw scanlines: a filter byte (none) followed by the RGB samples
+	size_t rowSize = 1 + (size_t)width * 3;
+	size_t rawSize = rowSize * height;
+	unsigned char *raw = malloc(rawSize);
+	if(raw == NULL){
+		printf("ERROR::IMAGE::Image_writePNG::Failed to allocate memory for image data\n");
+		return -1;
+	}
+	for(int y = 0; y < height; y++){
+		unsigned char *row = raw + y * rowSize;
+		row[0] = 0;
+		for(int x = 0; x < width; x++){
+			ToRGB(pixels[y * width + x], row + 1 + x * 3);
+		}
+	}
+
+	FILE *file = OpenFile(path, "Image_writePNG");
+	if(file == NULL){
+		free(raw);
+		return -1;
+	}
+	BuildCRCTable();
+
+	static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	fwrite(signature, 1, 8, file);
+
+	unsigned char header[13] = {
+		width >> 24, width >> 16, width >> 8, width,
+		height >> 24, height >> 16, height >> 8, height,
+		8, 2, 0, 0, 0 // 8 bits per channel, RGB, deflate, adaptive filtering, no interlace
+	};
+	PNGChunk chunk = PNGChunk_begin(file, "IHDR", sizeof(header));
+	PNGChunk_write(&chunk, header, sizeof(header));
+	PNGChunk_end(&chunk);
+
+	// zlib stream made of stored deflate blocks
+	size_t numBlocks = (rawSize + DEFLATE_MAX_STORED - 1) / DEFLATE_MAX_STORED;
+	if(numBlocks == 0) numBlocks = 1;
+	uint32_t dataSize = 2 + numBlocks * 5 + rawSize + 4;
+	chunk = PNGChunk_begin(file, "IDAT", dataSize);
+	static const unsigned char zlibHeader[2] = {0x78, 0x01};
+	PNGChunk_write(&chunk, zlibHeader, 2);
+
+	uint32_t adlerA = 1, adlerB = 0;
+	size_t offset = 0;
+	for(size_t block = 0; block < numBlocks; block++){
+		size_t length = rawSize - offset < DEFLATE_MAX_STORED ? rawSize - offset : DEFLATE_MAX_STORED;
+		unsigned char blockHeader[5] = {
+			block == numBlocks - 1, length & 0xFF, (length >> 8) & 0xFF, ~length & 0xFF, (~length >> 8) & 0xFF
+		};
+		PNGChunk_write(&chunk, blockHeader, 5);
+		PNGChunk_write(&chunk, raw + offset, length);
+		for(size_t i = offset; i < offset + length; i++){
+			adlerA = (adlerA + raw[i]) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+		}
+		offset += length;
+	}
+	uint32_t adler = (adlerB << 16) | adlerA;
+	unsigned char adlerBytes[4] = {adler >> 24, adler >> 16, adler >> 8, adler};
+	PNGChunk_write(&chunk, adlerBytes, 4);
+	PNGChunk_end(&chunk);
+
+	chunk = PNGChunk_begin(file, "IEND", 0);
+	PNGChunk_end(&chunk);
+
+	free(raw);
+	return fclose(file) == 0 ? 0 : -1;
+}
+
+
+// ───── PFM ─────
+
+int Image_writePFM(const char *path, const uint32_t *pixels, int width, int height){
+	FILE *file = OpenFile(path, "Image_writePFM");
+	if(file == NULL) return -1;
+
+	// a negative scale marks little-endian data, rows are stored bottom to top
+	fprintf(file, "PF\n%d %d\n-1.0\n", width, height);
+	for(int y = height - 1; y >= 0; y--){
+		for(int x = 0; x < width; x++){
+			unsigned char rgb[3];
+			ToRGB(pixels[y * width + x], rgb);
+			for(int c = 0; c < 3; c++){
+				float value = rgb[c] / 255.0f;
+				unsigned char bytes[4];
+				uint32_t bits;
+				memcpy(&bits, &value, 4);
+				bytes[0] = bits;
+				bytes[1] = bits >> 8;
+				bytes[2] = bits >> 16;
+				bytes[3] = bits >> 24;
+				fwrite(bytes, 1, 4, file);
+			}
+		}
+	}
+	return fclose(file) == 0 ? 0 : -1;
+}
+
+static int HasExtension(const char *path, const char *extension){
+	size_t length = strlen(path);
+	size_t extensionLength = strlen(extension);
+	if(length < extensionLength) return 0;
+	const char *end = path + length - extensionLength;
+	for(size_t i = 0; i < extensionLength; i++){
+		char c = end[i];
+		if(c >= 'A' && c <= 'Z') c += 'a' - 'A';
+		if(c != extension[i]) return 0;
+	}
+	return 1;
+}
+
+bool Image_isSupported(const char *path){
+	return HasExtension(path, ".ppm") || HasExtension(path, ".png") || HasExtension(path, ".pfm");
+}
+
+int Image_write(const char *path, const uint32_t *pixels, int width, int height){
+	if(HasExtension(path, ".ppm")) return Image_writePPM(path, pixels, width, height);
+	if(HasExtension(path, ".png")) return Image_writePNG(path, pixels, width, height);
+	if(HasExtension(path, ".pfm")) return Image_writePFM(path, pixels, width, height);
+	printf("ERROR::IMAGE::Image_write::Unsupported output format %s\n", path);
+	return -1;
+}
@@ -1,229 +1,272 @@
 #include<SDL3/SDL.h>
 #include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
 #include<math.h>
-#include<time.h>
 #include<pthread.h>
 #include"project.h"
 
 #define WIDTH 750
 #define HEIGHT 450
 
+/** Rate at which the event loop copies the framebuffer to the window, in frames per second. */
+#define PRESENT_RATE 60
 
+/**
+ * Copies the last published frame to the window. SDL only allows it on the main thread, so the event loop
+ * presents between two events and the workers never touch SDL.
+ */
 typedef struct{
-	SDL_Surface *surface;
 	SDL_Window *window;
+	Framebuffer *framebuffer;
+	/** Statistics and hardware counters of the presentation, guarded by the mutex of the framebuffer. */
+	RenderStats stats;
+	PerfStages perf;
+}Presenter;
+
+/**
+ * Thread rendering frames in the background, so that the event loop never waits for a frame.
+ *
+ * The event loop posts the camera pose and the window size with RenderThread_request, which also
+ * cancels the frame in progress. Requests posted while a frame is running coalesce into one.
+ */
+typedef struct{
 	Scene *scene;
-	int index, nThread;
-	int *starts, *ends;
-	int *threadStates;
-	int *currents, *helped;
+	Renderer *renderer;
+	Framebuffer *framebuffer;
+	Presenter *presenter;
 	int antiAliasingFactor;
-	pthread_mutex_t *mutex;
-}ThreadData;
-
-void Display(Scene *scene, SDL_Window *window, int nThread, bool verbose, int antiAliasingFactor);
-
-Color GetPixelColor(float i, float j, ThreadData *data){
-	Point *p;
-	Scene *scene = data->scene;
-	SDL_Surface *surface = data->surface;
-	int factor = data->antiAliasingFactor;
-	float aspectRatio = (float)surface->h / surface->w;
-
-	float viewportWidth = 2 * tan(scene->camera->fov / 2);
-	float viewportHeight = viewportWidth * aspectRatio;
-
-	int width = surface->w*factor;
-	int height = surface->h*factor;
+	pthread_t thread;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t requested;
+	/** Pose, size and render mode of the next frame, guarded by mutex. */
+	Camera camera;
+	Point position;
+	int width, height;
+	RenderMode mode;
+	bool pending;
+	bool shutdown;
+}RenderThread;
+
+static void Present(SDL_Window *window, const Framebuffer *framebuffer){
+	SDL_Surface *surface = SDL_GetWindowSurface(window);
+	if(surface == NULL) return;
 
-	float dx = ((i + 0.5)/width - 0.5) * viewportWidth;
-	float dy = (0.5 - (j + 0.5)/height) * viewportHeight;
+	// the window may have been resized after the frame was rendered, only the common area is copied
+	int width = framebuffer->width < surface->w ? framebuffer->width : surface->w;
+	int height = framebuffer->height < surface->h ? framebuffer->height : surface->h;
+	const uint32_t *pixels = Framebuffer_front(framebuffer);
 
-	Point *pixelPosition = scene->camera->position;
-	pixelPosition = Point_translate(pixelPosition, scene->camera->front);
-	pixelPosition = Point_translate(pixelPosition, Vector_scale(scene->camera->right, dx));
-	pixelPosition = Point_translate(pixelPosition, Vector_scale(scene->camera->up, dy));
+	if(SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+	for(int y = 0; y < height; y++){
+		memcpy((uint8_t*)surface->pixels + y * surface->pitch, pixels + y * framebuffer->width, width * sizeof(uint32_t));
+	}
+	if(SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+	SDL_UpdateWindowSurface(window);
+}
 
-	Vector direction = Vector_normalize(Vector_fromPoints(scene->camera->position, pixelPosition));
-	Ray *ray = Line_init(scene->camera->position, direction);
+/**
+ * @brief Shows the last frame published by the render thread, if there is a new one. Main thread only.
+ */
+void Presenter_present(Presenter *presenter){
+	Framebuffer *framebuffer = presenter->framebuffer;
+	// held for the whole blit, so a resize cannot free the front buffer while it is read
+	pthread_mutex_lock(&framebuffer->mutex);
+	if(Framebuffer_acquire(framebuffer) && framebuffer->width > 0){
+		double start = GetTimeMs();
+		STATS_TIMER_START(present);
+		PERF_BEGIN(PERF_STAGE_PRESENT);
+		Present(presenter->window, framebuffer);
+		PERF_END();
+		STATS_TIMER_STOP(STAT_TIMER_PRESENT, present);
+		Trace_complete("present", TRACE_THREAD_PRESENTER, start, GetTimeMs(), NULL, 0);
+		Stats_flush(&presenter->stats);
+		Perf_flush(&presenter->perf);
+	}
+	pthread_mutex_unlock(&framebuffer->mutex);
+}
 
-	return TraceRay(scene, ray);
+void Presenter_init(Presenter *presenter, SDL_Window *window, Framebuffer *framebuffer){
+	presenter->window = window;
+	presenter->framebuffer = framebuffer;
+	Stats_reset(&presenter->stats);
+	Perf_reset(&presenter->perf);
 }
 
-void *thread_function(void *args){
-	ThreadData *data = (ThreadData*)args;
-	int index = data->index;
-	int factor = data->antiAliasingFactor;
-	int height = data->surface->h;
-	SDL_Surface *surface = data->surface;
-	SDL_Window *window = data->window;
-	
-	Color *colors = NULL;
-	if(data->antiAliasingFactor > 1){
-		colors = malloc(factor * factor * sizeof(Color));
-		if(colors == NULL){
-			printf("ERROR::MAIN::thread_function::Failed to allocate memory for color array\n");
-			return NULL;
-		}
+/**
+ * Prints the rays, the statistics and the hardware counters of the frames displayed since the previous call,
+ * then clears them.
+ */
+static void PrintStats(RenderThread *renderThread){
+	if(!STATS_ENABLED && !PERF_ENABLED) return;
+	Renderer *renderer = renderThread->renderer;
+	RayCounters rays = Renderer_rayCounters(renderer);
+	RenderStats stats = Renderer_stats(renderer);
+	ModelCosts costs = {NULL, 0};
+	Renderer_modelCosts(renderer, &costs);
+	for(int i = 0; i < renderer->pool->numWorkers; i++){
+		char label[32];
+		snprintf(label, sizeof(label), "worker %d", i);
+		PerfStages perf = Renderer_perf(renderer, i);
+		Perf_print(&perf, label);
 	}
+	Renderer_resetCounters(renderer);
+
+	Framebuffer *framebuffer = renderThread->framebuffer;
+	pthread_mutex_lock(&framebuffer->mutex);
+	Stats_merge(&stats, &renderThread->presenter->stats);
+	Stats_reset(&renderThread->presenter->stats);
+	PerfStages presenterPerf = renderThread->presenter->perf;
+	Perf_reset(&renderThread->presenter->perf);
+	pthread_mutex_unlock(&framebuffer->mutex);
+	Perf_print(&presenterPerf, "presenter");
+
+	printf("primary rays: %llu, shadow rays: %llu, reflection rays: %llu\n",
+		(unsigned long long)rays.primary, (unsigned long long)rays.shadow, (unsigned long long)rays.reflection);
+	Stats_print(&stats);
+	Stats_printModelCosts(&costs, renderThread->scene, 5);
+	Stats_freeModelCosts(&costs);
+}
 
-	for(int i = data->starts[index]; i < data->ends[index]; i+=factor){
-		pthread_mutex_lock(&data->mutex[index]);
-		data->currents[index] = i;
-		pthread_mutex_unlock(&data->mutex[index]);
-		for(int j = 0; j < height*factor; j+=factor){
-			Color color;
-			
-			if(factor == 1){
-				color = GetPixelColor(i, j, data);
-			}
-			else{
-				for(int k = i; k < i + factor; k++){
-					for(int l = j; l < j + factor; l++){
-						colors[(k-i)*factor + (l-j)] = GetPixelColor(k, l, data);
-					}
-				}
-				color = Color_average(colors, factor*factor);
-			}
+static void *RenderThreadMain(void *args){
+	RenderThread *renderThread = (RenderThread*)args;
+	Framebuffer *framebuffer = renderThread->framebuffer;
+	Camera camera;
+	Point position;
 
-			SDL_Rect pixel = (SDL_Rect) {i/factor, j/factor, 1, 1};
-			SDL_FillSurfaceRect(surface, &pixel, Color_extract(color));
+	while(1){
+		pthread_mutex_lock(&renderThread->mutex);
+		while(!renderThread->pending && !renderThread->shutdown){
+			pthread_cond_wait(&renderThread->requested, &renderThread->mutex);
 		}
-		SDL_UpdateWindowSurface(window);
-	}
-	if(factor > 1) free(colors);
-	pthread_mutex_lock(&data->mutex[index]);
-	data->threadStates[index] = 1;
-	pthread_mutex_unlock(&data->mutex[index]);
-
-	pthread_t tid;
-	for(int i = 0; i < data->nThread; i++){
-		pthread_mutex_lock(&data->mutex[i]);
-		if(data->threadStates[i] == 0 && data->helped[i] == 0){
-			data->helped[i] = 1;
-			data->ends[index] = data->ends[i];
-			data->ends[i] = (data->currents[i] + data->ends[i]) / 2;
-			data->starts[index] = data->ends[i];
-			pthread_mutex_unlock(&data->mutex[i]);
-
-			pthread_create(&tid, NULL, thread_function, data);
-			pthread_join(tid, NULL);
-			break;
-		}else{
-			pthread_mutex_unlock(&data->mutex[i]);
+		if(renderThread->shutdown){
+			pthread_mutex_unlock(&renderThread->mutex);
+			return NULL;
 		}
+		camera = renderThread->camera;
+		position = renderThread->position;
+		camera.position = &position;
+		int width = renderThread->width;
+		int height = renderThread->height;
+		renderThread->renderer->mode = renderThread->mode;
+		renderThread->pending = false;
+		pthread_mutex_unlock(&renderThread->mutex);
+
+		// shallow copy of the scene seen from the snapshot of the camera, the event loop keeps moving the original
+		Scene view = *renderThread->scene;
+		view.camera = &camera;
+
+		if(Framebuffer_resize(framebuffer, width, height) != 0) continue;
+		double start = GetTimeMs();
+
+		// a coarse preview is on screen within a few milliseconds, then refined while the camera stays still
+		RenderPass passes[RENDERER_MAX_PASSES];
+		int numPasses = Renderer_progressivePasses(renderThread->antiAliasingFactor, passes);
+		bool completed = true;
+		for(int i = 0; i < numPasses && completed; i++){
+			int result = Renderer_renderPass(renderThread->renderer, &view, Framebuffer_back(framebuffer), width, height, width, passes[i]);
+
+			// a request posted between the snapshot and the start of the pass does not cancel it, the pass is stale
+			pthread_mutex_lock(&renderThread->mutex);
+			completed = result == 0 && !renderThread->pending;
+			pthread_mutex_unlock(&renderThread->mutex);
+
+			if(completed) Framebuffer_publish(framebuffer);
+		}
+		Trace_complete(completed ? "frame" : "cancelled frame", TRACE_THREAD_RENDER, start, GetTimeMs(), NULL, 0);
+		if(!completed) continue;
+
+		printf("Display took %.0f ms\n", GetTimeMs() - start);
+		PrintStats(renderThread);
 	}
 }
 
-Scene *CreateScene(int numObj, char **objs){
-	float fov = 90 * M_PI / 180;
-	Camera *camera = Camera_new(Point_init(0, 0, 20), Vector_init(0, 0, -1), Vector_init(0, 1, 0), fov);
-	Scene *scene = Scene_init(camera);
-
-	Material mat;
-	
-	
-	float floorY = -10;
-	mat.diffuse = COLOR_BLUE;
-	mat.specular = COLOR_BLACK;
-	mat.reflexivity = 0;
-	mat.specularExponent = 0;
-	mat.ambient = 0.05;
-	Model *floor = Model_createRectXZ(Point_init(-500, floorY, -500), 1000, 1000, mat);
-
-	int numSphere = 8;
-	Model **spheres = malloc(numSphere * sizeof(Model*));
-	if(spheres == NULL){
-		printf("ERROR::MAIN::CreateScene::Failed to allocate memory for spheres array\n");
-		return scene;
+bool RenderThread_start(RenderThread *renderThread, Scene *scene, Renderer *renderer, Presenter *presenter, int antiAliasingFactor){
+	renderThread->scene = scene;
+	renderThread->renderer = renderer;
+	renderThread->framebuffer = presenter->framebuffer;
+	renderThread->presenter = presenter;
+	renderThread->antiAliasingFactor = antiAliasingFactor;
+	renderThread->mode = RENDER_MODE_COLOR;
+	renderThread->pending = false;
+	renderThread->shutdown = false;
+	pthread_mutex_init(&renderThread->mutex, NULL);
+	pthread_cond_init(&renderThread->requested, NULL);
+	if(pthread_create(&renderThread->thread, NULL, RenderThreadMain, renderThread) != 0){
+		printf("ERROR::MAIN::RenderThread_start::Failed to create render thread\n");
+		return false;
 	}
+	return true;
+}
 
-	float radius = 10;
-	mat.diffuse = COLOR_GREEN;
-	mat.specular = Color_fromRGB(0.5, 0.5, 0.5);
-	mat.specularExponent = 32;
-	mat.ambient = 0.05;
-	mat.reflexivity = 1;
-	spheres[0] = Model_createSphere(Point_init(10, floorY+radius, -20), radius, mat);
-
-	radius = 3;
-	mat.diffuse = COLOR_RED;
-	mat.reflexivity = 0;
-	spheres[1] = Model_createSphere(Point_init(-5, floorY+radius, -10), radius, mat);
-
-	radius = 1;
-	mat.diffuse = COLOR_YELLOW;
-	mat.reflexivity = 0;
-	spheres[2] = Model_createSphere(Point_init(10, floorY+radius, -10), radius, mat);
-
-	radius = 2;
-	mat.diffuse = COLOR_GREEN;
-	mat.reflexivity = 0;
-	spheres[3] = Model_createSphere(Point_init(5, floorY+radius, -12), radius, mat);
-	
-	radius = 4;
-	mat.diffuse = COLOR_ORANGE;
-	mat.reflexivity = 0;
-	spheres[4] = Model_createSphere(Point_init(20, floorY+radius, -12), radius, mat);
-
-	radius = 15;
-	mat.diffuse = COLOR_YELLOW;
-	mat.reflexivity = 0.2;
-	spheres[5] = Model_createSphere(Point_init(-20, floorY+radius, -30), radius, mat);
-	
-	radius = 1.5;
-	mat.diffuse = COLOR_CYAN;
-	mat.reflexivity = 0;
-	spheres[6] = Model_createSphere(Point_init(5, floorY+radius, -2), radius, mat);
-	
-	radius = 1.5;
-	mat.diffuse = COLOR_MAGENTA;
-	mat.reflexivity = 0;
-	spheres[7] = Model_createSphere(Point_init(-10, floorY+radius, 0), radius, mat);
-
-	Light *lightSource = Light_new(Point_init(15, 10, -1), 2, COLOR_WHITE);
-	Light_setAttenuation(lightSource, 1, 0.0000, 0.0000);
-	Scene_fill(scene, lightSource, &floor, 1);
-	Scene_addModels(scene, spheres, numSphere);
-
-	if(numObj <= 0) return scene;
-
-	Model **objects = malloc(numObj * sizeof(Model*));
-	if(objects == NULL){
-		printf("ERROR::MAIN::CreateScene::Failed to allocate memory for objects array\n");
-		return scene;
-	}
-	for(int i = 0; i < numObj; i++){
-		objects[i] = Model_fromOBJ(objs[i]);
-		Vector translation = Vector_init(0, floorY - objects[i]->center->y + objects[i]->boundingRadius, 0);
-		Model_translate(objects[i], translation);
-	}
+/**
+ * @brief Asks for a frame of the given camera pose, cancelling the frame in progress.
+ */
+void RenderThread_request(RenderThread *renderThread, const Camera *camera, int width, int height){
+	pthread_mutex_lock(&renderThread->mutex);
+	renderThread->camera = *camera;
+	renderThread->position = *camera->position;
+	renderThread->width = width;
+	renderThread->height = height;
+	renderThread->pending = true;
+	Renderer_cancel(renderThread->renderer);
+	pthread_cond_signal(&renderThread->requested);
+	pthread_mutex_unlock(&renderThread->mutex);
+}
 
-	Scene_addModels(scene, objects, numObj);
+/**
+ * @brief Switches the next frames to the next render mode: the scene, then each cost heatmap.
+ */
+void RenderThread_nextMode(RenderThread *renderThread){
+	pthread_mutex_lock(&renderThread->mutex);
+	renderThread->mode = (renderThread->mode + 1) % RENDER_NUM_MODES;
+	pthread_mutex_unlock(&renderThread->mutex);
+}
 
-	printf("Scene size is %zu bytes\n", Scene_size(scene));
+void RenderThread_stop(RenderThread *renderThread){
+	pthread_mutex_lock(&renderThread->mutex);
+	renderThread->shutdown = true;
+	Renderer_cancel(renderThread->renderer);
+	pthread_cond_signal(&renderThread->requested);
+	pthread_mutex_unlock(&renderThread->mutex);
+	pthread_join(renderThread->thread, NULL);
+	pthread_mutex_destroy(&renderThread->mutex);
+	pthread_cond_destroy(&renderThread->requested);
+}
 
-	return scene;
+void RequestFrame(Scene *scene, SDL_Window *window, RenderThread *renderThread){
+	int width, height;
+	if(!SDL_GetWindowSizeInPixels(window, &width, &height)){
+		printf("ERROR::SDL::GetWindowSizeInPixels::%s\n", SDL_GetError());
+		return;
+	}
+	RenderThread_request(renderThread, scene->camera, width, height);
 }
 
-void SimulateScene(Scene *scene, SDL_Window *window, int antiAliasingFactor){
-	int nThread = 12;
-	Display(scene, window, nThread, 1, antiAliasingFactor);
+void SimulateScene(Scene *scene, SDL_Window *window, RenderThread *renderThread){
+	RequestFrame(scene, window, renderThread);
 
 	SDL_Event event;
-	int numFrame = 1;
 	while(1){
-		while(SDL_PollEvent(&event)){
+		// wakes up at least PRESENT_RATE times per second to show the frames published meanwhile
+		if(!SDL_WaitEventTimeout(&event, 1000 / PRESENT_RATE)){
+			Presenter_present(renderThread->presenter);
+			continue;
+		}
+
+		// the queue is drained before requesting a frame, so a burst of events triggers a single render
+		bool display = false;
+		do{
 			if(event.type == SDL_EVENT_QUIT){
 				return;
 			}
 			else if(event.type == SDL_EVENT_WINDOW_RESIZED){
-				Display(scene, window, nThread, 1, antiAliasingFactor);
+				display = true;
 			}
 			else if(event.type == SDL_EVENT_KEY_DOWN){
 				SDL_Keycode key = event.key.key;
-				bool display = true;
+				bool moved = true;
 
 				switch(key){
 					case SDLK_ESCAPE:
@@ -259,16 +302,19 @@ void SimulateScene(Scene *scene, SDL_Window *window, int antiAliasingFactor){
 					case SDLK_G:
 						Camera_ProcessMovement(scene->camera, CAMERA_MOVEMENT_ROTATE_DOWN);
 						break;
+					case SDLK_H:
+						RenderThread_nextMode(renderThread);
+						break;
 					default:
-						display = false;
+						moved = false;
 						break;
 				}
-
-				if(display)
-					Display(scene, window, nThread, 1, antiAliasingFactor);
+				display = display || moved;
 			}
-		}
-		SDL_Delay(50);
+		}while(SDL_PollEvent(&event));
+
+		if(display) RequestFrame(scene, window, renderThread);
+		Presenter_present(renderThread->presenter);
 	}
 }
 
@@ -300,66 +346,35 @@ int main(int argc, char **argv) {
 	if(argc >= 2){
 		antiAliasingFactor = atoi(argv[1]);
 	}
-	srand(time(NULL));
 	SDL_Window* window = InitWindow();
 	if(window == NULL) return 1;
 
-	Scene *scene = CreateScene(argc - 2, argv + 2);
-	SDL_Delay(200);
-	SimulateScene(scene, window, antiAliasingFactor);
-}
-
-void Display(Scene *scene, SDL_Window *window, int nThread, bool verbose, int antiAliasingFactor){
-	pthread_t *tid = malloc(nThread * sizeof(pthread_t));
-	SDL_Surface *surface = SDL_GetWindowSurface(window);
-
-	ThreadData **threadDatas = malloc(nThread * sizeof(ThreadData*));
-	int *starts = malloc(nThread * sizeof(int));
-	int *ends = malloc(nThread * sizeof(int));
-	int *currents = calloc(nThread, sizeof(int));
-	int *helped = calloc(nThread, sizeof(int));
-	int *threadStates = calloc(nThread, sizeof(int));
-	pthread_mutex_t *mutex = malloc(nThread * sizeof(pthread_mutex_t));
-	if(starts == NULL || ends == NULL || currents == NULL || helped == NULL || threadStates == NULL || mutex == NULL){
-		printf("ERROR::MAIN::Display::Failed to allocate memory for thread control arrays\n");
-		return;
+	// RAYTRACING_TRACE=file.json records a timeline of the session
+	const char *tracePath = getenv("RAYTRACING_TRACE");
+	if(tracePath != NULL && Trace_begin(0) == 0){
+		Trace_nameThread(TRACE_THREAD_RENDER, "render");
+		Trace_nameThread(TRACE_THREAD_PRESENTER, "main (present)");
 	}
-	clock_t start = clock();
 
-	for (int i = 0; i < nThread; i++) {
-		pthread_mutex_init(&mutex[i], NULL);
-		starts[i] = i * surface->w / nThread * antiAliasingFactor;
-		ends[i] = (i + 1) * surface->w / nThread * antiAliasingFactor;
-
-		threadDatas[i] = malloc(sizeof(ThreadData));
-		if(threadDatas[i] == NULL){
-			printf("ERROR::MAIN::Display::Failed to allocate memory for ThreadData\n");
-			return;
-		}
-		threadDatas[i]->threadStates = threadStates;
-		threadDatas[i]->index = i;
-		threadDatas[i]->nThread = nThread;
-		threadDatas[i]->mutex = mutex;
-
-		threadDatas[i]->surface = surface;
-		threadDatas[i]->window = window;
-		threadDatas[i]->scene = scene;
-		threadDatas[i]->starts = starts;
-		threadDatas[i]->ends = ends;
-		threadDatas[i]->currents = currents;
-		threadDatas[i]->helped = helped;
-		threadDatas[i]->antiAliasingFactor = antiAliasingFactor;
-	}
-
-	for(int i = 0; i < nThread; i++){
-		pthread_create(&tid[i], NULL, thread_function, threadDatas[i]);
-	}
-	for(int i = 0; i < nThread; i++){
-		pthread_join(tid[i], NULL);
-	}
+	Scene *scene = CreateScene(argc - 2, argv + 2);
+	SDL_Delay(200);
 
-	SDL_UpdateWindowSurface(window);
-	clock_t end = clock();
-	float time = (float)(end - start) / CLOCKS_PER_SEC * 1000;
-	if(verbose) printf("Display took %.0f ms\n", time);
+	ThreadPool *pool = ThreadPool_new(0);
+	if(pool == NULL) return 1;
+	Renderer *renderer = Renderer_new(pool);
+	if(renderer == NULL) return 1;
+	Framebuffer *framebuffer = Framebuffer_new(WIDTH, HEIGHT);
+	if(framebuffer == NULL) return 1;
+	Presenter presenter;
+	Presenter_init(&presenter, window, framebuffer);
+	RenderThread renderThread;
+	if(!RenderThread_start(&renderThread, scene, renderer, &presenter, antiAliasingFactor)) return 1;
+
+	SimulateScene(scene, window, &renderThread);
+
+	RenderThread_stop(&renderThread);
+	if(tracePath != NULL && Trace_end(tracePath) == 0) printf("Trace written to %s\n", tracePath);
+	Framebuffer_free(framebuffer);
+	Renderer_free(renderer);
+	ThreadPool_free(pool);
 }
@@ -12,22 +12,76 @@ Model *Model_new(){
 		return NULL;
 	}
 	model->type = GENERIC;
+	model->numVertices = 0;
+	model->vertices = NULL;
 	model->numTriangles = 0;
-	model->triangles = NULL;
+	model->indices = NULL;
+	model->triangleMaterials = NULL;
 	model->center = NULL;
 	model->boundingRadius = 0;
+	model->bvh = NULL;
+	model->pack = NULL;
 	return model;
 }
 
+/**
+ * Allocates the vertex array, the index buffer and the per-triangle material ids of a model.
+ * Materials ids are initialized to 0.
+ */
+int AllocateMesh(Model *model, int numVertices, int numTriangles){
+	model->vertices = malloc(numVertices * sizeof(Point));
+	model->indices = malloc(3 * numTriangles * sizeof(unsigned int));
+	model->triangleMaterials = calloc(numTriangles, sizeof(unsigned short));
+	if(model->vertices == NULL || model->indices == NULL || model->triangleMaterials == NULL){
+		printf("ERROR::MODEL::AllocateMesh::Failed to allocate memory for mesh arrays\n");
+		free(model->vertices);
+		free(model->indices);
+		free(model->triangleMaterials);
+		return 0;
+	}
+	model->numVertices = numVertices;
+	model->numTriangles = numTriangles;
+	return 1;
+}
+
+void SetTriangle(Model *model, int i, unsigned int a, unsigned int b, unsigned int c){
+	model->indices[3*i] = a;
+	model->indices[3*i + 1] = b;
+	model->indices[3*i + 2] = c;
+}
+
 Model *Model_createSphere(Point *center, float radius, Material material){
-	int numPoints = (LAT_DIVS + 1) * LON_DIVS;
-	Point **points = malloc(numPoints * sizeof(Point*));
-	if(points == NULL){
-		printf("ERROR::MODEL::Model_createSphere::Failed to allocate memory for sphere points\n");
+	Model *sphere = Model_new();
+	if(sphere == NULL) return NULL;
+
+	// analytic, the mesh is only generated by Model_tessellate
+	sphere->boundingRadius = radius;
+	sphere->center = center;
+	sphere->type = SPHERE;
+
+	sphere->materials = malloc(sizeof(Material));
+	if(sphere->materials == NULL){
+		printf("ERROR::MODEL::Model_createSphere::Failed to allocate memory for sphere material\n");
 		return NULL;
 	}
-	Model *sphere = Model_new();
+	sphere->numMaterials = 1;
+	sphere->materials[0] = material;
+	return sphere;
+}
 
+int Model_tessellate(Model *model){
+	if(model == NULL) return -1;
+	if(model->type == GENERIC || model->numTriangles > 0) return 0;
+
+	int numPoints = (LAT_DIVS + 1) * LON_DIVS;
+	int tri_count = LAT_DIVS * LON_DIVS * 2;
+	if(!AllocateMesh(model, numPoints, tri_count)){
+		printf("ERROR::MODEL::Model_tessellate::Failed to allocate memory for sphere mesh\n");
+		return -1;
+	}
+
+	Point *center = model->center;
+	float radius = model->boundingRadius;
 	int index = 0;
 	for (int i = 0; i <= LAT_DIVS; i++) {
 		float theta = M_PI * i / LAT_DIVS; // polar angle from 0 to PI
@@ -38,18 +92,11 @@ Model *Model_createSphere(Point *center, float radius, Material material){
 			float y = center->y + radius * sin(theta) * sin(phi);
 			float z = center->z + radius * cos(theta);
 
-			points[index++] = Point_init(x, y, z);
+			model->vertices[index++] = (Point){x, y, z};
 		}
 	}
 
 	// Create triangles
-	int tri_count = LAT_DIVS * LON_DIVS * 2;
-	sphere->triangles = malloc(tri_count * sizeof(Triangle*));
-	if(sphere->triangles == NULL){
-		printf("ERROR::MODEL::Model_createSphere::Failed to allocate memory for sphere triangles\n");
-		return NULL;
-	}
-	sphere->numTriangles = tri_count;
 	int t = 0;
 	for (int i = 0; i < LAT_DIVS; i++) {
 		for (int j = 0; j < LON_DIVS; j++) {
@@ -61,34 +108,13 @@ Model *Model_createSphere(Point *center, float radius, Material material){
 			int next_right = (i + 1) * LON_DIVS + right;
 
 			// Triangle 1
-			sphere->triangles[t++] = Triangle_init(
-				points[curr],
-				points[next],
-				points[next_right],
-				0
-			);
+			SetTriangle(model, t++, curr, next, next_right);
 
 			// Triangle 2
-			sphere->triangles[t++] = Triangle_init(
-				points[curr],
-				points[next_right],
-				points[curr_right],
-				0
-			);
+			SetTriangle(model, t++, curr, next_right, curr_right);
 		}
 	}
-	sphere->boundingRadius = radius;
-	sphere->center = center;
-	sphere->type = SPHERE;
-
-	sphere->materials = malloc(sizeof(Material));
-	if(sphere->materials == NULL){
-		printf("ERROR::MODEL::Model_createSphere::Failed to allocate memory for sphere material\n");
-		return NULL;
-	}
-	sphere->numMaterials = 1;
-	sphere->materials[0] = material;
-	return sphere;
+	return 0;
 }
 
 Model *Model_createRectXY(Point *origin, float width, float height, Material material){
@@ -103,22 +129,17 @@ Model *Model_createRectXY(Point *origin, float width, float height, Material mat
 	rect->center = Point_init(x + width/2, y + height/2, z);
 	rect->boundingRadius = sqrt(pow(width/2, 2) + pow(height/2, 2));
 
-	Point *p1, *p2, *p3;
-
-	p1 = Point_init(x + width, y, z);
-	p2 = Point_init(x, y + height, z);
-	p3 = Point_init(x + width, y + height, z);
-
-
-	rect->numTriangles = 2;
-
-	rect->triangles = malloc(rect->numTriangles *sizeof(Triangle*));
-	if(rect->triangles == NULL){
-		printf("ERROR::MODEL::Model_createRectXY::Failed to allocate memory for rectangle triangles\n");
+	if(!AllocateMesh(rect, 4, 2)){
+		printf("ERROR::MODEL::Model_createRectXY::Failed to allocate memory for rectangle mesh\n");
 		return NULL;
 	}
-	rect->triangles[0] = Triangle_init(origin, p1, p2, 0);
-	rect->triangles[1] = Triangle_init(p1, p2, p3, 0);
+	rect->vertices[0] = *origin;
+	rect->vertices[1] = (Point){x + width, y, z};
+	rect->vertices[2] = (Point){x, y + height, z};
+	rect->vertices[3] = (Point){x + width, y + height, z};
+
+	SetTriangle(rect, 0, 0, 1, 2);
+	SetTriangle(rect, 1, 1, 2, 3);
 
 	rect->materials = malloc(sizeof(Material));
 	if(rect->materials == NULL){
@@ -127,6 +148,7 @@ Model *Model_createRectXY(Point *origin, float width, float height, Material mat
 	}
 	rect->numMaterials = 1;
 	rect->materials[0] = material;
+	Model_buildBVH(rect);
 	return rect;
 }
 
@@ -142,22 +164,17 @@ Model *Model_createRectXZ(Point *origin, float width, float height, Material mat
 	rect->center = Point_init(x + width/2, y, z + height/2);
 	rect->boundingRadius = sqrt(pow(width/2, 2) + pow(height/2, 2));
 
-	Point *p1, *p2, *p3;
-
-	p1 = Point_init(x + width, y, z);
-	p2 = Point_init(x, y, z + height);
-	p3 = Point_init(x + width, y, z + height);
-
-
-	rect->numTriangles = 2;
-
-	rect->triangles = malloc(rect->numTriangles *sizeof(Triangle*));
-	if(rect->triangles == NULL){
-		printf("ERROR::MODEL::Model_createRectXZ::Failed to allocate memory for rectangle triangles\n");
+	if(!AllocateMesh(rect, 4, 2)){
+		printf("ERROR::MODEL::Model_createRectXZ::Failed to allocate memory for rectangle mesh\n");
 		return NULL;
 	}
-	rect->triangles[0] = Triangle_init(origin, p2, p1, 0);
-	rect->triangles[1] = Triangle_init(p1, p2, p3, 0);
+	rect->vertices[0] = *origin;
+	rect->vertices[1] = (Point){x + width, y, z};
+	rect->vertices[2] = (Point){x, y, z + height};
+	rect->vertices[3] = (Point){x + width, y, z + height};
+
+	SetTriangle(rect, 0, 0, 2, 1);
+	SetTriangle(rect, 1, 1, 2, 3);
 
 	rect->materials = malloc(sizeof(Material));
 	if(rect->materials == NULL){
@@ -166,6 +183,7 @@ Model *Model_createRectXZ(Point *origin, float width, float height, Material mat
 	}
 	rect->numMaterials = 1;
 	rect->materials[0] = material;
+	Model_buildBVH(rect);
 	return rect;
 }
 
@@ -181,22 +199,17 @@ Model *Model_createRectYZ(Point *origin, float width, float height, Material mat
 	rect->center = Point_init(x, y + height/2, z + width/2);
 	rect->boundingRadius = sqrt(pow(width/2, 2) + pow(height/2, 2));
 
-	Point *p1, *p2, *p3;
-
-	p1 = Point_init(x, y, z + width);
-	p2 = Point_init(x, y + height, z);
-	p3 = Point_init(x, y + height, z + width);
-
-
-	rect->numTriangles = 2;
-
-	rect->triangles = malloc(rect->numTriangles *sizeof(Triangle*));
-	if(rect->triangles == NULL){
-		printf("ERROR::MODEL::Model_createRectYZ::Failed to allocate memory for rectangle triangles\n");
+	if(!AllocateMesh(rect, 4, 2)){
+		printf("ERROR::MODEL::Model_createRectYZ::Failed to allocate memory for rectangle mesh\n");
 		return NULL;
 	}
-	rect->triangles[0] = Triangle_init(origin, p1, p2, 0);
-	rect->triangles[1] = Triangle_init(p1, p2, p3, 0);
+	rect->vertices[0] = *origin;
+	rect->vertices[1] = (Point){x, y, z + width};
+	rect->vertices[2] = (Point){x, y + height, z};
+	rect->vertices[3] = (Point){x, y + height, z + width};
+
+	SetTriangle(rect, 0, 0, 1, 2);
+	SetTriangle(rect, 1, 1, 2, 3);
 
 	rect->materials = malloc(sizeof(Material));
 	if(rect->materials == NULL){
@@ -205,6 +218,7 @@ Model *Model_createRectYZ(Point *origin, float width, float height, Material mat
 	}
 	rect->numMaterials = 1;
 	rect->materials[0] = material;
+	Model_buildBVH(rect);
 	return rect;
 }
 
@@ -216,16 +230,23 @@ Model *Model_createBox(Point *origin, float width, float height, float depth, Ma
 	float y = origin->y;
 	float z = origin->z;
 
-	Point *points[8] = {
-		Point_init(x, y, z),                               // 0: origin
-		Point_init(x + width, y, z),                       // 1
-		Point_init(x, y + height, z),                      // 2
-		Point_init(x + width, y + height, z),              // 3
-		Point_init(x, y, z + depth),                       // 4
-		Point_init(x + width, y, z + depth),               // 5
-		Point_init(x, y + height, z + depth),              // 6
-		Point_init(x + width, y + height, z + depth)       // 7
+	if(!AllocateMesh(box, 8, 12)){
+		printf("ERROR::MODEL::Model_createBox::Failed to allocate memory for box mesh\n");
+		return NULL;
+	}
+	Point points[8] = {
+		{x, y, z},                               // 0: origin
+		{x + width, y, z},                       // 1
+		{x, y + height, z},                      // 2
+		{x + width, y + height, z},              // 3
+		{x, y, z + depth},                       // 4
+		{x + width, y, z + depth},               // 5
+		{x, y + height, z + depth},              // 6
+		{x + width, y + height, z + depth}       // 7
 	};
+	for (int i = 0; i < 8; ++i) {
+		box->vertices[i] = points[i];
+	}
 
 	box->center = Point_init(x + width / 2, y + height / 2, z + depth / 2);
 	box->boundingRadius = sqrt(width*width + height*height + depth*depth) / 2;
@@ -240,16 +261,9 @@ Model *Model_createBox(Point *origin, float width, float height, float depth, Ma
 		{2, 3, 6}, {3, 6, 7}      // Top
 	};
 
-	box->numTriangles = 12;
-	box->triangles = malloc(box->numTriangles * sizeof(Triangle *));
-	if(box->triangles == NULL){
-		printf("ERROR::MODEL::Model_createBox::Failed to allocate memory for box triangles\n");
-		return NULL;
-	}
-
 	for (int i = 0; i < 12; ++i) {
 		int *f = faces[i];
-		box->triangles[i] = Triangle_init(points[f[0]], points[f[1]], points[f[2]], 0);
+		SetTriangle(box, i, f[0], f[1], f[2]);
 	}
 
 
@@ -260,50 +274,104 @@ Model *Model_createBox(Point *origin, float width, float height, float depth, Ma
 	}
 	box->numMaterials = 1;
 	box->materials[0] = material;
+	Model_buildBVH(box);
 	return box;
 }
 
+/**
+ * Stores the triangles in the pack in the order of the BVH primitives.
+ * Edges are computed from the current vertices, exactly like Triangle_intersect does.
+ */
+static void PackTriangles(Model *model){
+	if(model->pack == NULL) return;
+	for(int i = 0; i < model->bvh->numPrimitives; i++){
+		Triangle t = Model_getTriangle(model, model->bvh->primitives[i]);
+		TrianglePack_set(model->pack, i, &t);
+	}
+}
 
-void Model_translate(Model *model, Vector translation){
+void Model_buildBVH(Model *model){
 	if(model == NULL) return;
-	model->center = Point_translate(model->center, translation);
+	BVH_free(model->bvh);
+	TrianglePack_free(model->pack);
+	model->bvh = NULL;
+	model->pack = NULL;
+	if(model->numTriangles == 0) return;
+
+	AABB *bounds = malloc(model->numTriangles * sizeof(AABB));
+	if(bounds == NULL){
+		printf("ERROR::MODEL::Model_buildBVH::Failed to allocate memory for triangle bounds\n");
+		return;
+	}
 	for(int i = 0; i < model->numTriangles; i++){
-		Triangle_translate(model->triangles[i], translation);
+		Triangle t = Model_getTriangle(model, i);
+		bounds[i] = AABB_extend(AABB_extend(AABB_fromPoint(t.a), t.b), t.c);
+	}
+	model->bvh = BVH_build(bounds, model->numTriangles, MODEL_BVH_LEAF_SIZE);
+	free(bounds);
+	if(model->bvh == NULL) return;
+	model->pack = TrianglePack_new(model->numTriangles);
+	if(model->pack == NULL){
+		BVH_free(model->bvh);
+		model->bvh = NULL;
+		return;
+	}
+	PackTriangles(model);
+}
+
+AABB Model_getBounds(Model *model){
+	AABB bounds = AABB_empty();
+	if(model == NULL) return bounds;
+	if(model->type == SPHERE || model->type == LIGHT){
+		// same minimum radius used by the analytic intersection
+		float r = fmax(0.1, model->boundingRadius);
+		Point *c = model->center;
+		bounds.min = (Point){c->x - r, c->y - r, c->z - r};
+		bounds.max = (Point){c->x + r, c->y + r, c->z + r};
+		return bounds;
+	}
+	if(model->bvh != NULL) return BVH_bounds(model->bvh);
+	for(int i = 0; i < model->numVertices; i++){
+		bounds = AABB_extend(bounds, model->vertices[i]);
+	}
+	return bounds;
+}
+
+void Model_translate(Model *model, Vector translation){
+	if(model == NULL) return;
+	*model->center = Point_translate(model->center, translation);
+	for(int i = 0; i < model->numVertices; i++){
+		Point *p = &model->vertices[i];
+		p->x += translation.x;
+		p->y += translation.y;
+		p->z += translation.z;
 	}
+	BVH_translate(model->bvh, translation);
+	PackTriangles(model);
 }
 
 void Model_scale(Model *model, float scalar){
 	if(model == NULL || scalar < 0) return;
 	model->boundingRadius *= scalar;
-	for(int i = 0; i < model->numTriangles; i++){
-		Vector v;
-		Triangle *t = model->triangles[i];
-
-		v = Vector_fromPoints(model->center, t->a);
-		v = Vector_scale(v, scalar);
-		free(t->a);
-		t->a = Point_translate(model->center, v);
-
-		v = Vector_fromPoints(model->center, t->b);
-		v = Vector_scale(v, scalar);
-		free(t->b);
-		t->b = Point_translate(model->center, v);
-
-		v = Vector_fromPoints(model->center, t->c);
-		v = Vector_scale(v, scalar);
-		free(t->c);
-		t->c = Point_translate(model->center, v);
+	Point *center = model->center;
+	for(int i = 0; i < model->numVertices; i++){
+		Point *p = &model->vertices[i];
+		p->x = center->x + (p->x - center->x) * scalar;
+		p->y = center->y + (p->y - center->y) * scalar;
+		p->z = center->z + (p->z - center->z) * scalar;
 	}
+	if(model->bvh != NULL) Model_buildBVH(model);
 }
 
 
-static Point *g_refPoint;
-int compareTriangles(const void *a, const void *b) {
-	Triangle *t1 = *(Triangle **)a;
-	Triangle *t2 = *(Triangle **)b;
+typedef struct{
+	int triangle;
+	float distance;
+}TriangleDistance;
 
-	float d1 = Point_distanceSquared(g_refPoint, Triangle_center(t1));
-	float d2 = Point_distanceSquared(g_refPoint, Triangle_center(t2));
+int compareTriangles(const void *a, const void *b) {
+	float d1 = ((TriangleDistance*)a)->distance;
+	float d2 = ((TriangleDistance*)b)->distance;
 
 	if (d1 < d2) return -1;
 	else if (d1 > d2) return 1;
@@ -312,12 +380,52 @@ int compareTriangles(const void *a, const void *b) {
 
 void Model_sortTriangles(Model *model, Point *point){
 	if(model == NULL || point == NULL) return;
-	if(model->triangles == NULL) return;
-	g_refPoint = point;
-	qsort(model->triangles, model->numTriangles, sizeof(Triangle*), compareTriangles);
+	if(model->indices == NULL) return;
+
+	int n = model->numTriangles;
+	TriangleDistance *order = malloc(n * sizeof(TriangleDistance));
+	unsigned int *indices = malloc(3 * n * sizeof(unsigned int));
+	unsigned short *materials = malloc(n * sizeof(unsigned short));
+	if(order == NULL || indices == NULL || materials == NULL){
+		printf("ERROR::MODEL::Model_sortTriangles::Failed to allocate memory for sorting\n");
+		free(order);
+		free(indices);
+		free(materials);
+		return;
+	}
+	for(int i = 0; i < n; i++){
+		Triangle t = Model_getTriangle(model, i);
+		Point center = Triangle_center(&t);
+		order[i].triangle = i;
+		order[i].distance = Point_distanceSquared(point, &center);
+	}
+	qsort(order, n, sizeof(TriangleDistance), compareTriangles);
+
+	for(int i = 0; i < n; i++){
+		int src = order[i].triangle;
+		indices[3*i] = model->indices[3*src];
+		indices[3*i + 1] = model->indices[3*src + 1];
+		indices[3*i + 2] = model->indices[3*src + 2];
+		materials[i] = model->triangleMaterials[src];
+	}
+	free(order);
+	free(model->indices);
+	free(model->triangleMaterials);
+	model->indices = indices;
+	model->triangleMaterials = materials;
+	if(model->bvh != NULL) Model_buildBVH(model);
 }
 
 
+Material Material_new(Color diffuse, float ambient, Color specular, int specularExponent, float reflexivity){
+	Material material;
+	material.diffuse = diffuse;
+	material.ambient = ambient;
+	material.specular = specular;
+	material.specularExponent = specularExponent;
+	material.reflexivity = reflexivity;
+	return material;
+}
 
 size_t Material_size(Material material){
 	return sizeof(material);
@@ -327,15 +435,15 @@ size_t Model_size(Model *model){
 	size_t size = 0;
 
 	size += sizeof(*model);
-	size += model->numTriangles * sizeof(*model->triangles);
+	size += model->numVertices * sizeof(*model->vertices);
+	size += 3 * model->numTriangles * sizeof(*model->indices);
+	size += model->numTriangles * sizeof(*model->triangleMaterials);
 	size += Point_size(model->center);
+	size += BVH_size(model->bvh);
+	size += TrianglePack_size(model->pack);
 
 	for(int i = 0; i < model->numMaterials; i++){
 		size += Material_size(model->materials[i]);
 	}
-	for(int i = 0; i < model->numTriangles; i++){
-		size += Triangle_size(model->triangles[i]);
-	}
-
 	return size;
 }
\ No newline at end of file
@@ -12,6 +12,15 @@ int ExtractVertexIndex(const char *token) {
 }
 
 
+/**
+ * Frees the names of the materials of an .mtl file.
+ */
+static void FreeMaterialNames(char **names, int count){
+	if(names == NULL) return;
+	for(int i = 0; i < count; i++) free(names[i]);
+	free(names);
+}
+
 int LoadMaterials(char *fileName, char ***names, Material **materials) {
 	FILE *file = fopen(fileName, "r");
 	if (!file) {
@@ -24,14 +33,12 @@ int LoadMaterials(char *fileName, char ***names, Material **materials) {
 	int materialCount = -1;
 
 	char **materialNames = malloc(materialCapacity * sizeof(char*));
-	if(materialNames == NULL){
-		printf("ERROR::OBJLOADER::LoadMaterials::Failed to allocate memory for material names array\n");
-		return 0;
-	}
-
-	Material *mats = malloc(materialCapacity * sizeof(Material));
-	if(mats == NULL){
-		printf("ERROR::OBJLOADER::LoadMaterials::Failed to allocate memory for material array\n");
+	Material *mats = calloc(materialCapacity, sizeof(Material));
+	if(materialNames == NULL || mats == NULL){
+		printf("ERROR::OBJLOADER::LoadMaterials::Failed to allocate memory for material arrays\n");
+		free(materialNames);
+		free(mats);
+		fclose(file);
 		return 0;
 	}
 
@@ -44,22 +51,25 @@ int LoadMaterials(char *fileName, char ***names, Material **materials) {
 		if (!word) continue;
 
 		if (strcmp(word, "newmtl") == 0) {
-			currentName = strdup(strtok(NULL, " \t\r\n"));
-			materialCount++;
-			materialNames[materialCount] = currentName;
-			if (materialCount >= materialCapacity) {
-				materialCapacity *= 2;
-				materialNames = realloc(materialNames, materialCapacity * sizeof(char*));
-				if(materialNames == NULL){
-					printf("ERROR::OBJLOADER::LoadMaterials::Failed to reallocate memory for material names array\n");
-					return 0;
-				}
-				mats = realloc(mats, materialCapacity * sizeof(Material));
-				if(mats == NULL){
-					printf("ERROR::OBJLOADER::LoadMaterials::Failed to reallocate memory for material array\n");
+			if (materialCount + 1 >= materialCapacity) {
+				// the arrays are replaced one at a time, the old blocks stay valid until both succeed
+				char **grownNames = realloc(materialNames, 2 * materialCapacity * sizeof(char*));
+				if(grownNames != NULL) materialNames = grownNames;
+				Material *grownMats = grownNames != NULL ? realloc(mats, 2 * materialCapacity * sizeof(Material)) : NULL;
+				if(grownMats == NULL){
+					printf("ERROR::OBJLOADER::LoadMaterials::Failed to reallocate memory for material arrays\n");
+					FreeMaterialNames(materialNames, materialCount + 1);
+					free(mats);
+					fclose(file);
 					return 0;
 				}
+				mats = grownMats;
+				materialCapacity *= 2;
 			}
+			currentName = strdup(strtok(NULL, " \t\r\n"));
+			materialCount++;
+			materialNames[materialCount] = currentName;
+			mats[materialCount] = (Material){0};
 		} else if (strcmp(word, "Kd") == 0 && currentName != NULL) {
 			r = atof(strtok(NULL, " \t\r\n"));
 			g = atof(strtok(NULL, " \t\r\n"));
@@ -94,57 +104,72 @@ int getIndex(char *word, char **array, int n){
 	return -1;
 }
 
+/**
+ * Geometry and materials of an OBJ file being parsed. Every array is owned until it is handed to the model.
+ */
+typedef struct{
+	Point *points;
+	int pointCount, pointCapacity;
+	unsigned int *indices;
+	unsigned short *triangleMaterials;
+	int triCount, triCapacity;
+	char **materialNames;
+	Material *materials;
+	int numMaterials;
+}OBJData;
+
+static void OBJData_free(OBJData *data){
+	free(data->points);
+	free(data->indices);
+	free(data->triangleMaterials);
+	FreeMaterialNames(data->materialNames, data->numMaterials);
+	free(data->materials);
+}
 
-Model* Model_fromOBJ(const char *fileName) {
-	char *fullPath = GetFullPath((char *)fileName);
-	FILE *file = fopen(fullPath, "r");
-	if (!file) {
-		perror("Failed to open OBJ file");
-		return NULL;
-	}
-
-	char *directoryPath = GetDirectoryPath(fullPath);
-
-	Point **points = NULL;
-	int pointCapacity = 64, pointCount = 0;
-	points = malloc(sizeof(Point*) * pointCapacity);
-	if(points == NULL){
-		printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for points array\n");
-		return NULL;
-	}
+/**
+ * Doubles the capacity of the vertex array. On failure the array keeps its content and is still owned.
+ */
+static bool GrowPoints(OBJData *data){
+	Point *points = realloc(data->points, 2 * sizeof(Point) * data->pointCapacity);
+	if(points == NULL) return false;
+	data->points = points;
+	data->pointCapacity *= 2;
+	return true;
+}
 
-	Triangle **triangles = NULL;
-	int triCapacity = 64, triCount = 0;
-	triangles = malloc(sizeof(Triangle*) * triCapacity);
-	if(triangles == NULL){
-		printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for triangles array\n");
-		return NULL;
-	}
+/**
+ * Doubles the capacity of the triangle arrays. On failure both arrays are still owned, possibly already grown.
+ */
+static bool GrowTriangles(OBJData *data){
+	unsigned int *indices = realloc(data->indices, 2 * 3 * sizeof(unsigned int) * data->triCapacity);
+	if(indices == NULL) return false;
+	data->indices = indices;
+	unsigned short *triangleMaterials = realloc(data->triangleMaterials, 2 * sizeof(unsigned short) * data->triCapacity);
+	if(triangleMaterials == NULL) return false;
+	data->triangleMaterials = triangleMaterials;
+	data->triCapacity *= 2;
+	return true;
+}
 
+/**
+ * Reads the vertices, the triangles and the materials of an OBJ file.
+ *
+ * @param directoryPath Directory of the OBJ file, the .mtl files are relative to it.
+ *
+ * @return false if an allocation fails or the file has too many materials, the arrays read so far stay in data.
+ */
+static bool ParseOBJ(FILE *file, const char *directoryPath, OBJData *data){
 	char line[LINE_MAX_LEN];
-	int numMaterials;
-	char **materialNames;
-	Material *materials;
 	int actualMaterial = 0;
 	while (fgets(line, sizeof(line), file)) {
 		if (line[0] == 'v' && line[1] == ' ') {
 			float x, y, z;
 			sscanf(line + 2, "%f %f %f", &x, &y, &z);
-			if (pointCount >= pointCapacity) {
-				pointCapacity *= 2;
-				points = realloc(points, sizeof(Point*) * pointCapacity);
-				if(points == NULL){
-					printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to reallocate memory for points array\n");
-					return NULL;
-				}
+			if (data->pointCount >= data->pointCapacity && !GrowPoints(data)) {
+				printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to reallocate memory for points array\n");
+				return false;
 			}
-			Point *p = malloc(sizeof(Point));
-			if(p == NULL){
-				printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for Point\n");
-				return NULL;
-			}
-			p->x = x; p->y = y; p->z = z;
-			points[pointCount++] = p;
+			data->points[data->pointCount++] = (Point){x, y, z};
 		} else if (line[0] == 'f' && line[1] == ' ') {
 			char *tokens[3];
 			int tokenCount = 0;
@@ -162,74 +187,157 @@ Model* Model_fromOBJ(const char *fileName) {
 			int i3 = ExtractVertexIndex(tokens[2]);
 
 			if (i1 <= 0 || i2 <= 0 || i3 <= 0) continue;
+			if (i1 > data->pointCount || i2 > data->pointCount || i3 > data->pointCount) continue;
 
-			if (triCount >= triCapacity) {
-				triCapacity *= 2;
-				triangles = realloc(triangles, sizeof(Triangle*) * triCapacity);
-				if(triangles == NULL){
-					printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to reallocate memory for triangles array\n");
-					return NULL;
-				}
+			if (data->triCount >= data->triCapacity && !GrowTriangles(data)) {
+				printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to reallocate memory for triangles arrays\n");
+				return false;
 			}
 
-			Triangle *t = Triangle_init(points[i1 - 1], points[i2 - 1], points[i3 - 1], actualMaterial);
-			triangles[triCount++] = t;
+			int triCount = data->triCount++;
+			data->indices[3*triCount] = i1 - 1;
+			data->indices[3*triCount + 1] = i2 - 1;
+			data->indices[3*triCount + 2] = i3 - 1;
+			data->triangleMaterials[triCount] = actualMaterial;
 		}
 		else{
 			char *word = strtok(line, " \t\r\n");
+			if(word == NULL) continue;
 			if(strcmp(word, "mtllib") == 0){
 				word = strtok(NULL, " \t\r\n");
-				numMaterials = LoadMaterials(strcat(directoryPath, word), &materialNames, &materials);
+				char *materialPath = malloc(strlen(directoryPath) + strlen(word) + 1);
+				if(materialPath == NULL){
+					printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for material path\n");
+					return false;
+				}
+				strcpy(materialPath, directoryPath);
+				strcat(materialPath, word);
+				// a later mtllib replaces the materials of the previous one
+				FreeMaterialNames(data->materialNames, data->numMaterials);
+				free(data->materials);
+				data->materialNames = NULL;
+				data->materials = NULL;
+				data->numMaterials = LoadMaterials(materialPath, &data->materialNames, &data->materials);
+				free(materialPath);
+				if(data->numMaterials > MODEL_MAX_MATERIALS){
+					printf("ERROR::OBJLOADER::Model_fromOBJ::Too many materials (%d), at most %d are supported\n", data->numMaterials, MODEL_MAX_MATERIALS);
+					return false;
+				}
 			}
 			else if(strcmp(word, "usemtl") == 0){
 				word = strtok(NULL, " \t\r\n");
-				actualMaterial = getIndex(word, materialNames, numMaterials);
+				actualMaterial = getIndex(word, data->materialNames, data->numMaterials);
 				if(actualMaterial < 0) actualMaterial = 0;
 			}
 		}
 	}
+	return true;
+}
+
+
+Model* Model_fromOBJ(const char *fileName) {
+	char *fullPath = GetFullPath((char *)fileName);
+	FILE *file = fullPath != NULL ? fopen(fullPath, "r") : NULL;
+	if (!file) {
+		perror("Failed to open OBJ file");
+		free(fullPath);
+		return NULL;
+	}
+
+	char *directoryPath = GetDirectoryPath(fullPath);
+	OBJData data = {0};
+	data.pointCapacity = 64;
+	data.triCapacity = 64;
+	data.points = malloc(sizeof(Point) * data.pointCapacity);
+	data.indices = malloc(3 * sizeof(unsigned int) * data.triCapacity);
+	data.triangleMaterials = malloc(sizeof(unsigned short) * data.triCapacity);
+	bool parsed = false;
+	if(directoryPath == NULL || data.points == NULL || data.indices == NULL || data.triangleMaterials == NULL){
+		printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for mesh arrays\n");
+	}
+	else{
+		parsed = ParseOBJ(file, directoryPath, &data);
+	}
 
 	fclose(file);
+	free(directoryPath);
+	if(parsed && (data.pointCount == 0 || data.triCount == 0)){
+		// the center and the bounds of an empty model are undefined
+		printf("ERROR::OBJLOADER::Model_fromOBJ::No vertices or triangles in %s\n", fullPath);
+		parsed = false;
+	}
+	free(fullPath);
+	if(!parsed){
+		OBJData_free(&data);
+		return NULL;
+	}
+	// the names are only needed to resolve usemtl
+	FreeMaterialNames(data.materialNames, data.numMaterials);
+	data.materialNames = NULL;
+
+	if(data.numMaterials == 0){
+		// no usable .mtl file, fall back to a single gray material
+		free(data.materials);
+		data.materials = malloc(sizeof(Material));
+		if(data.materials == NULL){
+			printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for default material\n");
+			OBJData_free(&data);
+			return NULL;
+		}
+		data.materials[0].diffuse = COLOR_GRAY;
+		data.materials[0].ambient = 0.05;
+		data.materials[0].specular = COLOR_BLACK;
+		data.materials[0].specularExponent = 0;
+		data.materials[0].reflexivity = 0;
+		data.numMaterials = 1;
+		for(int i = 0; i < data.triCount; i++) data.triangleMaterials[i] = 0;
+	}
 
 	Point *center = malloc(sizeof(Point));
-	if(center == NULL){
-		printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for model center\n");
+	Model *model = malloc(sizeof(Model));
+	if(center == NULL || model == NULL){
+		printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for Model\n");
+		free(center);
+		free(model);
+		OBJData_free(&data);
 		return NULL;
 	}
 	center->x = center->y = center->z = 0;
-	for (int i = 0; i < pointCount; i++) {
-		center->x += points[i]->x;
-		center->y += points[i]->y;
-		center->z += points[i]->z;
+	for (int i = 0; i < data.pointCount; i++) {
+		center->x += data.points[i].x;
+		center->y += data.points[i].y;
+		center->z += data.points[i].z;
 	}
-	center->x /= pointCount;
-	center->y /= pointCount;
-	center->z /= pointCount;
+	center->x /= data.pointCount;
+	center->y /= data.pointCount;
+	center->z /= data.pointCount;
 
 	float maxDist = 0;
-	for (int i = 0; i < pointCount; i++) {
-		float d = Point_distanceSquared(center, points[i]);
+	for (int i = 0; i < data.pointCount; i++) {
+		float d = Point_distanceSquared(center, &data.points[i]);
 		if (d > maxDist) maxDist = d;
 	}
 
-	Model *model = malloc(sizeof(Model));
-	if(model == NULL){
-		printf("ERROR::OBJLOADER::Model_fromOBJ::Failed to allocate memory for Model\n");
-		return NULL;
-	}
-	model->materials = materials;
-	model->numMaterials = numMaterials;
-	model->numTriangles = triCount;
-	model->triangles = triangles;
+	model->materials = data.materials;
+	model->numMaterials = data.numMaterials;
+	model->numVertices = data.pointCount;
+	model->vertices = data.points;
+	model->numTriangles = data.triCount;
+	model->indices = data.indices;
+	model->triangleMaterials = data.triangleMaterials;
 	model->center = center;
 	model->boundingRadius = sqrt(maxDist);
 	model->type = GENERIC;
+	model->bvh = NULL;
+	model->pack = NULL;
+	Model_buildBVH(model);
 
 	return model;
 }
 
-int Model_toOBJ(const Model *model, const char *fileName) {
+int Model_toOBJ(Model *model, const char *fileName) {
 	if (!model || !fileName) return -1;
+	if (Model_tessellate(model) != 0) return -1;
 
 	FILE *file = fopen(GetFullPath((char *)fileName), "w");
 	if (!file) {
@@ -237,20 +345,16 @@ int Model_toOBJ(const Model *model, const char *fileName) {
 		return -1;
 	}
 
-	int vertexIndex = 1;
-
-	for (int i = 0; i < model->numTriangles; ++i) {
-		Triangle *t = model->triangles[i];
-		fprintf(file, "v %f %f %f\n", t->a->x, t->a->y, t->a->z);
-		fprintf(file, "v %f %f %f\n", t->b->x, t->b->y, t->b->z);
-		fprintf(file, "v %f %f %f\n", t->c->x, t->c->y, t->c->z);
+	for (int i = 0; i < model->numVertices; ++i) {
+		Point *p = &model->vertices[i];
+		fprintf(file, "v %f %f %f\n", p->x, p->y, p->z);
 	}
 
 	for (int i = 0; i < model->numTriangles; ++i) {
-		fprintf(file, "f %d %d %d\n", vertexIndex, vertexIndex + 1, vertexIndex + 2);
-		vertexIndex += 3;
+		const unsigned int *index = model->indices + 3 * i;
+		fprintf(file, "f %u %u %u\n", index[0] + 1, index[1] + 1, index[2] + 1);
 	}
 
 	fclose(file);
 	return 0;
-}
\ No newline at end of file
+}
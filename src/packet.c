@@ -0,0 +1,21 @@
+#include<math.h>
+#include"packet.h"
+
+void RayPacket_init(RayPacket *packet, Point origin, const Vector directions[PACKET_SIZE], const Vector corners[4]){
+	packet->origin = origin;
+	for(int i = 0; i < PACKET_SIZE; i++){
+		packet->rays[i] = Line_init(origin, directions[i]);
+		packet->inverse[0][i] = 1 / packet->rays[i].direction.x;
+		packet->inverse[1][i] = 1 / packet->rays[i].direction.y;
+		packet->inverse[2][i] = 1 / packet->rays[i].direction.z;
+		packet->tMax[i] = INFINITY;
+	}
+
+	Vector center = Vector_sum(Vector_sum(corners[0], corners[1]), Vector_sum(corners[2], corners[3]));
+	for(int k = 0; k < 4; k++){
+		// the plane through two consecutive edges, facing the center of the pyramid
+		Vector normal = Vector_crossProduct(corners[k], corners[(k + 1) % 4]);
+		if(Vector_dot(normal, center) < 0) normal = Vector_scale(normal, -1);
+		packet->frustum[k] = normal;
+	}
+}
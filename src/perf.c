@@ -0,0 +1,208 @@
+#include<stdio.h>
+#include<string.h>
+#include<stdatomic.h>
+#include"perf.h"
+
+#if defined(RAYTRACING_PERF) && defined(__linux__)
+#define PERF_SUPPORTED 1
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h>
+#define PERF_RDPMC 1
+#endif
+#else
+#define PERF_SUPPORTED 0
+#endif
+
+static const char *stageNames[PERF_NUM_STAGES] = {"render", "traversal", "shadow", "shading", "present"};
+
+const char *Perf_stageName(PerfStage stage){
+	return stage < PERF_NUM_STAGES ? stageNames[stage] : "unknown";
+}
+
+void Perf_merge(PerfStages *target, const PerfStages *source){
+	for(int s = 0; s < PERF_NUM_STAGES; s++){
+		for(int e = 0; e < PERF_NUM_EVENTS; e++) target->counts[s][e] += source->counts[s][e];
+	}
+}
+
+void Perf_reset(PerfStages *stages){
+	memset(stages, 0, sizeof(PerfStages));
+}
+
+#if PERF_SUPPORTED
+
+/**
+ * Counters of a thread, opened the first time it enters a stage and kept until the process exits.
+ */
+typedef struct{
+	bool initialized;
+	bool available;
+	int fds[PERF_NUM_EVENTS];
+	/** Mapped pages of the counters, NULL if rdpmc cannot be used. */
+	struct perf_event_mmap_page *pages[PERF_NUM_EVENTS];
+	PerfStage stack[PERF_MAX_NESTING];
+	int depth;
+	uint64_t last[PERF_NUM_EVENTS];
+	PerfStages stages;
+}PerfThread;
+
+static _Thread_local PerfThread perfThread;
+
+static int OpenCounter(uint32_t type, uint64_t config){
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// counts the calling thread only, on any CPU
+	return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void OpenCounters(){
+	PerfThread *thread = &perfThread;
+	uint64_t cacheMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+	thread->fds[PERF_CYCLES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	thread->fds[PERF_INSTRUCTIONS] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	thread->fds[PERF_L1D_MISSES] = OpenCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheMiss);
+	thread->fds[PERF_LLC_MISSES] = OpenCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheMiss);
+	thread->fds[PERF_BRANCH_MISSES] = OpenCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+	long pageSize = sysconf(_SC_PAGESIZE);
+	for(int i = 0; i < PERF_NUM_EVENTS; i++){
+		thread->pages[i] = NULL;
+		if(thread->fds[i] < 0) continue;
+		thread->available = true;
+#ifdef PERF_RDPMC
+		void *page = mmap(NULL, pageSize, PROT_READ, MAP_SHARED, thread->fds[i], 0);
+		if(page != MAP_FAILED) thread->pages[i] = (struct perf_event_mmap_page*)page;
+#else
+		(void)pageSize;
+#endif
+	}
+	thread->initialized = true;
+}
+
+#ifdef PERF_RDPMC
+/**
+ * Reads a counter in user space, following the protocol of perf_event_mmap_page.
+ */
+static bool ReadUserCounter(const volatile struct perf_event_mmap_page *page, uint64_t *value){
+	uint32_t sequence;
+	do{
+		sequence = page->lock;
+		atomic_signal_fence(memory_order_seq_cst);
+		uint32_t index = page->index;
+		if(!page->cap_user_rdpmc || index == 0) return false;
+		int64_t count = __rdpmc(index - 1);
+		// the hardware counter is pmc_width bits wide, sign extended
+		int shift = 64 - page->pmc_width;
+		count = (int64_t)((uint64_t)count << shift) >> shift;
+		*value = page->offset + count;
+		atomic_signal_fence(memory_order_seq_cst);
+	}while(page->lock != sequence);
+	return true;
+}
+#endif
+
+static uint64_t ReadCounter(int event){
+	PerfThread *thread = &perfThread;
+	if(thread->fds[event] < 0) return 0;
+	uint64_t value = 0;
+#ifdef PERF_RDPMC
+	if(thread->pages[event] != NULL && ReadUserCounter(thread->pages[event], &value)) return value;
+#endif
+	if(read(thread->fds[event], &value, sizeof(value)) != sizeof(value)) return 0;
+	return value;
+}
+
+/**
+ * Reads every counter and adds the counts since the previous boundary to the innermost stage.
+ */
+static void Boundary(){
+	PerfThread *thread = &perfThread;
+	// stages nested deeper than the stack count in the deepest recorded one
+	int top = thread->depth < PERF_MAX_NESTING ? thread->depth : PERF_MAX_NESTING;
+	for(int i = 0; i < PERF_NUM_EVENTS; i++){
+		uint64_t now = ReadCounter(i);
+		if(top > 0) thread->stages.counts[thread->stack[top - 1]][i] += now - thread->last[i];
+		thread->last[i] = now;
+	}
+}
+
+void Perf_begin(PerfStage stage){
+	PerfThread *thread = &perfThread;
+	if(!thread->initialized) OpenCounters();
+	if(!thread->available) return;
+	Boundary();
+	if(thread->depth < PERF_MAX_NESTING) thread->stack[thread->depth] = stage;
+	thread->depth++;
+}
+
+void Perf_end(){
+	PerfThread *thread = &perfThread;
+	if(!thread->available || thread->depth == 0) return;
+	Boundary();
+	thread->depth--;
+}
+
+bool Perf_available(){
+	if(!perfThread.initialized) OpenCounters();
+	return perfThread.available;
+}
+
+void Perf_flush(PerfStages *target){
+	Perf_merge(target, &perfThread.stages);
+	Perf_reset(&perfThread.stages);
+}
+
+#else
+
+void Perf_begin(PerfStage stage){
+	(void)stage;
+}
+
+void Perf_end(){
+}
+
+bool Perf_available(){
+	return false;
+}
+
+void Perf_flush(PerfStages *target){
+	(void)target;
+}
+
+#endif
+
+static double PerKiloInstruction(uint64_t count, uint64_t instructions){
+	return instructions > 0 ? 1000.0 * count / instructions : 0;
+}
+
+void Perf_print(const PerfStages *stages, const char *label){
+	if(!PERF_ENABLED) return;
+	bool counted = false;
+	for(int s = 0; s < PERF_NUM_STAGES; s++) counted = counted || stages->counts[s][PERF_CYCLES] > 0 || stages->counts[s][PERF_INSTRUCTIONS] > 0;
+	if(!counted){
+		printf("%s: no hardware counters\n", label);
+		return;
+	}
+	printf("%s\n", label);
+	printf("  %-10s %14s %14s %6s %12s %12s %12s\n", "stage", "cycles", "instructions", "IPC", "L1D/kinstr", "LLC/kinstr", "branch/kinstr");
+	for(int s = 0; s < PERF_NUM_STAGES; s++){
+		const uint64_t *counts = stages->counts[s];
+		if(counts[PERF_CYCLES] == 0 && counts[PERF_INSTRUCTIONS] == 0) continue;
+		uint64_t instructions = counts[PERF_INSTRUCTIONS];
+		printf("  %-10s %14llu %14llu %6.2f %12.2f %12.2f %12.2f\n", stageNames[s],
+			(unsigned long long)counts[PERF_CYCLES], (unsigned long long)instructions,
+			counts[PERF_CYCLES] > 0 ? (double)instructions / counts[PERF_CYCLES] : 0,
+			PerKiloInstruction(counts[PERF_L1D_MISSES], instructions),
+			PerKiloInstruction(counts[PERF_LLC_MISSES], instructions),
+			PerKiloInstruction(counts[PERF_BRANCH_MISSES], instructions));
+	}
+}
@@ -2,124 +2,150 @@
 #include<math.h>
 #include<stdbool.h>
 #include"raytracer.h"
-
-#define SHADOW_SAMPLES 20
-
-typedef struct{
-	Point* point;
-	Vector normal;
-	Material material;
-
-	Model *model;
-}Hit;
-
-
-Hit Model_intersection(Model *model, Ray *l, bool triangleSorted);
-Color TraceRayR(Scene *scene, Ray *l, int depth);
-
-Color TraceRay(Scene *scene, Ray *ray){
-	return TraceRayR(scene, ray, 0);
+#include"stats.h"
+#include"perf.h"
+
+/** Shadow rays are traced in batches, the convergence of the estimate is checked after each of them. */
+#define SHADOW_BATCH_SIZE 4
+
+bool Scene_occluded(Scene *scene, Ray *ray, float tMin, float tMax, Model *ignore);
+Color TraceRayR(Scene *scene, Ray *l, Sampler *sampler, RayCounters *counters, int depth);
+static Color ShadeHit(Scene *scene, Ray *ray, Hit realHit, Sampler *sampler, RayCounters *counters, int depth);
+
+Color TraceRay(Scene *scene, Ray *ray, Sampler *sampler, RayCounters *counters){
+	counters->primary++;
+	STATS_TIMER_START(trace);
+	PERF_BEGIN(PERF_STAGE_SHADING);
+	Color color = TraceRayR(scene, ray, sampler, counters, 0);
+	PERF_END();
+	STATS_TIMER_STOP(STAT_TIMER_TRACE, trace);
+	return color;
 }
 
 Vector Reflect(Vector incident, Vector normal) {
 	return Vector_sum(incident, Vector_scale(normal, -2 * Vector_dot(incident, normal)));
 }
 
-int isInShadow(Scene *scene, Hit realHit, Point *lightPoint){
-	Vector toLight =  Vector_fromPoints(realHit.point, lightPoint);
-	Ray *shadowRay = Line_init(realHit.point, toLight);
-	for (int i = 0; i < scene->numModels; i++) {
-		if (scene->models[i] == realHit.model || scene->models[i] == NULL || scene->models[i]->type == LIGHT) continue;
-		Hit hit = Model_intersection(scene->models[i], shadowRay, false);
-		if (hit.point != NULL) {
-			float distToObj = Point_distanceSquared(hit.point, realHit.point);
-			float distToLight = Point_distanceSquared(lightPoint, hit.point);
-			if (distToObj < distToLight - 1e-5) {
-				return 1;
-			}
-		}
+int isInShadow(Scene *scene, Hit realHit, const Point *lightPoint){
+	Vector toLight =  Vector_fromPoints(&realHit.point, lightPoint);
+	Ray shadowRay = Line_init(realHit.point, toLight);
+	float distToLight = sqrt(toLight.normSquared);
+	return Scene_occluded(scene, &shadowRay, 0, distToLight - 1e-5, realHit.model);
+}
+
+/**
+ * Maps a point of the unit square to the unit disk (Shirley-Chiu concentric mapping), preserving the strata.
+ */
+static void ConcentricDisk(float u, float v, float *x, float *y){
+	float a = 2 * u - 1;
+	float b = 2 * v - 1;
+	if(a == 0 && b == 0){
+		*x = 0;
+		*y = 0;
+		return;
+	}
+	float r, theta;
+	if(fabsf(a) > fabsf(b)){
+		r = a;
+		theta = (M_PI / 4) * (b / a);
 	}
-	return 0;
+	else{
+		r = b;
+		theta = M_PI / 2 - (M_PI / 4) * (a / b);
+	}
+	*x = r * cosf(theta);
+	*y = r * sinf(theta);
 }
 
-float CalculateShadowFactor(Scene *scene, Hit realHit, Vector vectorLight){
+float CalculateShadowFactor(Scene *scene, Hit realHit, Vector vectorLight, Sampler *sampler, RayCounters *counters){
 	float epsilon = 1e-4;
 	Vector offset = Vector_scale(realHit.normal, epsilon);
-	realHit.point = Point_translate(realHit.point, offset);
-	int inShadow = 0;
-	float shadowFactor = 1;
+	realHit.point = Point_translate(&realHit.point, offset);
 	Light *light = scene->lightSource;
-	if(light->radius > 0){
-		Vector e1 = Vector_normalize(Vector_perpendicular(vectorLight));
-		e1 = Vector_scale(e1, light->radius * 1.2);
-
-		//check if the intersection point can be in shadow
-		int numCheck = 8;
-		float angle = 2 * M_PI / numCheck;
-		for(int i = 0; i < numCheck; i++){
-			e1 = Vector_rotate(e1, vectorLight, angle);
-			if(isInShadow(scene, realHit, Point_translate(light->position, e1))){
-				inShadow = 1;
-				break;
-			}
-		}
-		e1 = Vector_normalize(Vector_perpendicular(vectorLight));
-		if(inShadow){
-			int occluded = 0;
-			int numSamples = light->radius == 0 ? 1 : SHADOW_SAMPLES;
-			for (int s = 0; s < numSamples; s++) {
-				float theta = ((float)rand() / RAND_MAX) * 2 * M_PI;
-				float r = light->radius * sqrt((float)rand() / RAND_MAX);
-
-				Vector randomTraslation = Vector_rotate(e1, vectorLight, theta);
-				randomTraslation = Vector_scale(randomTraslation, r);
-				
-				Point *randomLightPoint = Point_translate(light->position, randomTraslation);
-
-				occluded += isInShadow(scene, realHit, randomLightPoint);
-			}
-			shadowFactor = 1.0 - ((float)occluded / numSamples);
-		}
+	if(light->radius <= 0){
+		counters->shadow++;
+		return 1 - isInShadow(scene, realHit, light->position);
 	}
-	else{
-		shadowFactor = 1 - isInShadow(scene, realHit, light->position);
+
+	// orthonormal frame of the light disk, facing the shaded point
+	Vector u = Vector_normalize(Vector_perpendicular(vectorLight));
+	Vector v = Vector_crossProduct(vectorLight, u);
+	u = Vector_scale(u, light->radius);
+	v = Vector_scale(v, light->radius);
+
+	int maxSamples = light->shadowSamples;
+	float threshold = light->shadowThreshold;
+
+	// scrambled Sobol points: every prefix of the sequence is stratified over the disk, so sampling can stop anywhere
+	uint32_t seed = Sampler_nextUInt(sampler);
+	int occluded = 0;
+	int numSamples = 0;
+	while(numSamples < maxSamples){
+		float sampleU, sampleV;
+		Sampler_sobol2D(numSamples, seed, &sampleU, &sampleV);
+		float diskX, diskY;
+		ConcentricDisk(sampleU, sampleV, &diskX, &diskY);
+
+		Vector translation = Vector_sum(Vector_scale(u, diskX), Vector_scale(v, diskY));
+		Point lightPoint = Point_translate(light->position, translation);
+		occluded += isInShadow(scene, realHit, &lightPoint);
+		numSamples++;
+
+		// after every batch, stop if the variance of the estimate is small enough:
+		// a first batch that agrees (fully lit or umbra) has no variance at all
+		if(numSamples % SHADOW_BATCH_SIZE == 0){
+			float p = (float)occluded / numSamples;
+			if(p * (1 - p) <= threshold * threshold * numSamples) break;
+		}
 	}
+	counters->shadow += numSamples;
+	if(numSamples < maxSamples) STATS_INCREMENT(STAT_SHADOW_EARLY_OUTS);
+	return 1.0 - (float)occluded / numSamples;
+}
 
-	return shadowFactor;
+void TracePacket(Scene *scene, RayPacket *packet, uint32_t active, Sampler *samplers, RayCounters *counters, Color *colors){
+	counters->primary += RayPacket_count(active);
+	STATS_TIMER_START(trace);
+	PERF_BEGIN(PERF_STAGE_SHADING);
+	Hit hits[PACKET_SIZE];
+	PERF_BEGIN(PERF_STAGE_TRAVERSAL);
+	Scene_intersectPacket(scene, packet, active, hits);
+	PERF_END();
+	// the secondary rays diverge, they are traced one by one
+	for(int i = 0; i < PACKET_SIZE; i++){
+		if(active & (1u << i)) colors[i] = ShadeHit(scene, &packet->rays[i], hits[i], &samplers[i], counters, 0);
+	}
+	PERF_END();
+	STATS_TIMER_STOP(STAT_TIMER_TRACE, trace);
 }
 
-Color TraceRayR(Scene *scene, Ray *ray, int depth){
-	float minDistance = -1;
+Color TraceRayR(Scene *scene, Ray *ray, Sampler *sampler, RayCounters *counters, int depth){
+	PERF_BEGIN(PERF_STAGE_TRAVERSAL);
+	Hit realHit = Scene_intersection(scene, ray, INFINITY);
+	PERF_END();
+	return ShadeHit(scene, ray, realHit, sampler, counters, depth);
+}
 
+/**
+ * Computes the color seen along a ray from its closest hit: direct light, shadows and reflections.
+ */
+static Color ShadeHit(Scene *scene, Ray *ray, Hit realHit, Sampler *sampler, RayCounters *counters, int depth){
 	Light *light = scene->lightSource;
-	Hit realHit;
-	realHit.point = NULL;
-
-	for(int i = 0; i < scene->numModels; i++){
-		if(scene->models[i] == NULL) continue;
-		if(realHit.point != NULL && Vector_dot(Vector_fromPoints(scene->models[i]->center, realHit.point), ray->direction) < 0 && Point_distanceSquared(scene->models[i]->center, realHit.point) > scene->models[i]->boundingRadius * scene->models[i]->boundingRadius){
-			continue;
-		}
-		Hit currentHit = Model_intersection(scene->models[i], ray, false);
-		if(currentHit.point != NULL){
-			float distance = Point_distanceSquared(ray->origin, currentHit.point);
-			if(minDistance == -1 || distance < minDistance){
-				realHit = currentHit;
-				minDistance = distance;
-			}
-		}
-	}
-	if(realHit.point == NULL) return Color_multiply(BACKGROUND_COLOR, light->color);
+	if(realHit.model == NULL) return Color_multiply(BACKGROUND_COLOR, light->color);
 	if (realHit.model->type == LIGHT) return realHit.material.diffuse;
 
-	Vector vectorLight = Vector_normalize(Vector_fromPoints(realHit.point, light->position));
+	Vector vectorLight = Vector_normalize(Vector_fromPoints(&realHit.point, light->position));
 
 	if(Vector_dot(realHit.normal, ray->direction) > 0)
 		realHit.normal = Vector_scale(realHit.normal, -1);
 
 	realHit.normal = Vector_normalize(realHit.normal);
 
-	float shadowFactor = CalculateShadowFactor(scene, realHit, vectorLight);
+	STATS_TIMER_START(shadow);
+	PERF_BEGIN(PERF_STAGE_SHADOW);
+	float shadowFactor = CalculateShadowFactor(scene, realHit, vectorLight, sampler, counters);
+	PERF_END();
+	STATS_TIMER_STOP(STAT_TIMER_SHADOW, shadow);
 
 	Vector oppositeDirection = Vector_normalize(Vector_scale(ray->direction, -1));
 
@@ -141,61 +167,58 @@ Color TraceRayR(Scene *scene, Ray *ray, int depth){
 		float epsilon = 1e-4;
 		Vector delta = Vector_scale(realHit.normal, epsilon);
 
-		Ray *reflexRay = Line_init(Point_translate(realHit.point, delta), reflex);
-		Color reflectedColor = TraceRayR(scene, reflexRay, depth + 1);
+		Ray reflexRay = Line_init(Point_translate(&realHit.point, delta), reflex);
+		counters->reflection++;
+		Color reflectedColor = TraceRayR(scene, &reflexRay, sampler, counters, depth + 1);
 		reflectedColor = Color_scale(reflectedColor, 0.95); // a model cannot reflect 100% of the light it absorbs
 		diffuseColor = Color_blend(diffuseColor, reflectedColor, realHit.material.reflexivity);
 	}
 	Color finalColor = Color_add(Color_add(diffuseColor, specularColor), ambientColor);
 
-	float distanceSquared = Point_distanceSquared(realHit.point, light->position);
+	float distanceSquared = Point_distanceSquared(&realHit.point, light->position);
 	float attenuation = light->constant + light->linear * sqrt(distanceSquared) + light->quadratic * distanceSquared;
 	attenuation = 1 / attenuation;
 
 	return Color_scale(finalColor, attenuation);
 }
 
-Point *intersection_Point(Ray *ray, Triangle *t){
-	Point *A, *B, *C;
-	A = t->a;
-	B = t->b;
-	C = t->c;
-	float EPSILON = 1e-5;
-	Vector e1 = Vector_fromPoints(A, B);
-	Vector e2 = Vector_fromPoints(A, C);
-
-	Vector h = Vector_crossProduct(ray->direction, e2);
-	float a = Vector_dot(e1, h);
-	if (fabs(a) < EPSILON) {
-		return NULL;
-	}
-
-	Vector s = Vector_fromPoints(A, ray->origin);
-	float u = Vector_dot(s, h) / a;
-	if (u < 0.0 || u > 1.0) {
-		return NULL;
-	}
-
-	Vector q = Vector_crossProduct(s, e1);
-	float v = Vector_dot(ray->direction, q) / a;
-	if (v < 0.0 || u + v > 1.0) {
-		return NULL;
-	}
-
-	float ti = Vector_dot(e2, q) / a;
-	//if intersection is in the opposite direction of the line exclude it
-	if (ti < 1e-6) return NULL;
-
+typedef struct{
+	Model *model;
+	int triangle;
+}MeshHitContext;
+
+bool Mesh_leafIntersection(void *context, const int *triangles, int count, Ray *ray, float *tMax){
+	MeshHitContext *ctx = (MeshHitContext*)context;
+	STATS_ADD(STAT_TRIANGLE_TESTS, count);
+	// the leaf is a contiguous range of the primitives, packed in the same order
+	const BVH *bvh = ctx->model->bvh;
+	int hit = TrianglePack_intersect(ctx->model->pack, (int)(triangles - bvh->primitives), count, ray, tMax);
+	if(hit < 0) return false;
+	ctx->triangle = bvh->primitives[hit];
+	return true;
+}
 
-	Point* intersectionPoint = Point_translate(ray->origin, Vector_scale(ray->direction, ti));
+/**
+ * Builds the hit of a ray with a sphere at the given distance.
+ */
+static Hit SphereHit(Model *sphere, Ray *ray, float distance){
+	Hit hit;
+	// P = O + t * D
+	Point intersection = Point_translate(&ray->origin, Vector_scale(ray->direction, distance));
 
-	return intersectionPoint;
+	hit.point = intersection;
+	hit.distance = distance;
+	hit.normal = Vector_fromPoints(sphere->center, &intersection);
+	hit.model = sphere;
+	hit.material = sphere->materials[0];
+	return hit;
 }
 
-Hit Sphere_intersection(Model *sphere, Ray *ray) {
+Hit Sphere_intersection(Model *sphere, Ray *ray, float tMax) {
 	Hit hit;
-	hit.point = NULL;
-	Point *O = ray->origin;
+	hit.model = NULL;
+	STATS_INCREMENT(STAT_SPHERE_TESTS);
+	Point *O = &ray->origin;
 	Vector D = ray->direction;
 	Point *C = sphere->center;
 	float r = fmax(0.1, sphere->boundingRadius);
@@ -222,56 +245,233 @@ Hit Sphere_intersection(Model *sphere, Ray *ray) {
 	if (t1 > 0) t = t1;
 	else if (t2 > 0) t = t2;
 	else return hit; // Both intersections are behind the camera
+	if (t >= tMax) return hit;
 
-	// Compute intersection point: P = O + t * D
-	Point* intersection = Point_translate(O, Vector_scale(D, t));
-
-	hit.point = intersection;
-	hit.normal = Vector_fromPoints(sphere->center, intersection);
-	hit.model = sphere;
-	hit.material = sphere->materials[0];
+	return SphereHit(sphere, ray, t);
+}
 
+/**
+ * Builds the hit of a ray with a triangle of a mesh at the given distance.
+ */
+static Hit MeshHit(Model *model, Ray *ray, int triangle, float distance){
+	Hit hit;
+	Triangle hitTriangle = Model_getTriangle(model, triangle);
+	hit.point = Point_translate(&ray->origin, Vector_scale(ray->direction, distance));
+	hit.distance = distance;
+	hit.normal = Triangle_getNormal(&hitTriangle);
+	hit.model = model;
+	hit.material = model->materials[hitTriangle.material];
 	return hit;
 }
 
-Hit Model_intersection(Model *model, Ray *ray, bool triangleSorted){
+Hit Model_intersection(Model *model, Ray *ray, float tMax){
 	if(model->type == SPHERE || model->type == LIGHT){
-		return Sphere_intersection(model, ray);
+		return Sphere_intersection(model, ray, tMax);
 	}
 	Hit hit;
-	hit.point = NULL;
-	float linePointDistance = Line_Point_distance(ray, model->center);
-	if(linePointDistance > model->boundingRadius){
-		return hit;
-	}
+	hit.model = NULL;
+
+	MeshHitContext ctx;
+	ctx.model = model;
+	ctx.triangle = -1;
+	float distance = tMax;
+	if(!BVH_intersect(model->bvh, ray, &distance, Mesh_leafIntersection, &ctx)) return hit;
+	return MeshHit(model, ray, ctx.triangle, distance);
+}
 
-	Point *q = Line_projectionPoint(ray, model->center);
-	Vector pq = Vector_fromPoints(ray->origin, q);
-	if(Vector_dot(pq, ray->direction) + model->boundingRadius < 0){
-		return hit;
+typedef struct{
+	Scene *scene;
+	Hit hit;
+}SceneHitContext;
+
+bool Scene_leafIntersection(void *context, const int *models, int count, Ray *ray, float *tMax){
+	SceneHitContext *ctx = (SceneHitContext*)context;
+	const SpherePool *pool = ctx->scene->spheres;
+	int first = (int)(models - ctx->scene->bvh->primitives);
+	bool hit = false;
+
+	// the spheres of the leaf are tested at once, then the meshes one by one
+	STATS_MODEL_START();
+	int sphere = SpherePool_intersect(pool, first, count, ray, tMax);
+	STATS_SPHERES_STOP(pool, models, first, count);
+	if(sphere >= 0){
+		ctx->hit = SphereHit(pool->models[sphere], ray, *tMax);
+		hit = true;
 	}
-
-	Point *intersection = NULL;
-	float minDistance = -1;
-	Triangle *hitTriangle = NULL;
-	for(int i = 0; i < model->numTriangles; i++){
-		Point *p = intersection_Point(ray, model->triangles[i]);
-		if(p != NULL){
-			float distance = Point_distanceSquared(ray->origin, p);
-			if(minDistance == -1 || distance < minDistance){
-				intersection = p;
-				hitTriangle = model->triangles[i];
-				minDistance = distance;
-				if(triangleSorted) break;
-			}
+	for(int i = 0; i < count; i++){
+		if(SpherePool_isSphere(pool, first + i)) continue;
+		STATS_MODEL_START();
+		Hit currentHit = Model_intersection(pool->models[first + i], ray, *tMax);
+		STATS_MODEL_STOP(models[i]);
+		if(currentHit.model != NULL){
+			ctx->hit = currentHit;
+			*tMax = currentHit.distance;
+			hit = true;
 		}
 	}
+	return hit;
+}
 
-	if(intersection == NULL) return hit;
+Hit Scene_intersection(Scene *scene, Ray *ray, float tMax){
+	SceneHitContext ctx;
+	ctx.scene = scene;
+	ctx.hit.model = NULL;
+	BVH_intersect(scene->bvh, ray, &tMax, Scene_leafIntersection, &ctx);
+	return ctx.hit;
+}
 
-	hit.point = intersection;
-	hit.normal = Triangle_getNormal(hitTriangle);
-	hit.model = model;
-	hit.material = model->materials[hitTriangle->material];
+typedef struct{
+	Model *model;
+	/** Closest triangle of every ray of the packet. */
+	int triangles[PACKET_SIZE];
+}MeshPacketContext;
+
+static uint32_t Mesh_leafPacket(void *context, const int *triangles, int count, RayPacket *packet, uint32_t active){
+	MeshPacketContext *ctx = (MeshPacketContext*)context;
+	const BVH *bvh = ctx->model->bvh;
+	int first = (int)(triangles - bvh->primitives);
+	uint32_t hit = 0;
+	for(int i = 0; i < PACKET_SIZE; i++){
+		if(!(active & (1u << i))) continue;
+		STATS_ADD(STAT_TRIANGLE_TESTS, count);
+		int triangle = TrianglePack_intersect(ctx->model->pack, first, count, &packet->rays[i], &packet->tMax[i]);
+		if(triangle < 0) continue;
+		ctx->triangles[i] = bvh->primitives[triangle];
+		hit |= 1u << i;
+	}
+	return hit;
+}
+
+/**
+ * Intersects the active rays of a packet with a mesh, writing the hits closer than their tMax.
+ *
+ * @return Mask of the rays that hit the mesh.
+ */
+static uint32_t Mesh_intersectPacket(Model *model, RayPacket *packet, uint32_t active, Hit *hits){
+	MeshPacketContext ctx;
+	ctx.model = model;
+	uint32_t hit = BVH_intersectPacket(model->bvh, packet, active, Mesh_leafPacket, &ctx);
+	for(int i = 0; i < PACKET_SIZE; i++){
+		if(hit & (1u << i)) hits[i] = MeshHit(model, &packet->rays[i], ctx.triangles[i], packet->tMax[i]);
+	}
+	return hit;
+}
+
+typedef struct{
+	Scene *scene;
+	Hit *hits;
+}ScenePacketContext;
+
+static uint32_t Scene_leafPacket(void *context, const int *models, int count, RayPacket *packet, uint32_t active){
+	ScenePacketContext *ctx = (ScenePacketContext*)context;
+	const SpherePool *pool = ctx->scene->spheres;
+	int first = (int)(models - ctx->scene->bvh->primitives);
+	uint32_t hit = 0;
+
+	STATS_MODEL_START();
+	for(int i = 0; i < PACKET_SIZE; i++){
+		if(!(active & (1u << i))) continue;
+		int sphere = SpherePool_intersect(pool, first, count, &packet->rays[i], &packet->tMax[i]);
+		if(sphere < 0) continue;
+		ctx->hits[i] = SphereHit(pool->models[sphere], &packet->rays[i], packet->tMax[i]);
+		hit |= 1u << i;
+	}
+	STATS_SPHERES_STOP(pool, models, first, count);
+	for(int i = 0; i < count; i++){
+		if(SpherePool_isSphere(pool, first + i)) continue;
+		STATS_MODEL_START();
+		hit |= Mesh_intersectPacket(pool->models[first + i], packet, active, ctx->hits);
+		STATS_MODEL_STOP(models[i]);
+	}
 	return hit;
-}
\ No newline at end of file
+}
+
+void Scene_intersectPacket(Scene *scene, RayPacket *packet, uint32_t active, Hit *hits){
+	ScenePacketContext ctx;
+	ctx.scene = scene;
+	ctx.hits = hits;
+	for(int i = 0; i < PACKET_SIZE; i++){
+		if(!(active & (1u << i))) continue;
+		hits[i].model = NULL;
+		packet->tMax[i] = INFINITY;
+	}
+	BVH_intersectPacket(scene->bvh, packet, active, Scene_leafPacket, &ctx);
+}
+
+bool Sphere_occluded(Model *sphere, Ray *ray, float tMin, float tMax){
+	STATS_INCREMENT(STAT_SPHERE_TESTS);
+	float r = fmax(0.1, sphere->boundingRadius);
+	Vector L = Vector_fromPoints(sphere->center, &ray->origin);
+
+	// the direction is normalized, so a = 1 and b is halved
+	float b = Vector_dot(L, ray->direction);
+	float c = Vector_dot(L, L) - r * r;
+	float discriminant = b * b - c;
+	if (discriminant < 0) return false;
+
+	float sqrt_discriminant = sqrt(discriminant);
+	float t1 = -b - sqrt_discriminant;
+	float t2 = -b + sqrt_discriminant;
+	return (t1 > tMin && t1 < tMax) || (t2 > tMin && t2 < tMax);
+}
+
+typedef struct{
+	Model *model;
+	float tMin;
+}MeshOcclusionContext;
+
+bool Mesh_leafOcclusion(void *context, const int *triangles, int count, Ray *ray, float *tMax){
+	MeshOcclusionContext *ctx = (MeshOcclusionContext*)context;
+	STATS_ADD(STAT_TRIANGLE_TESTS, count);
+	const BVH *bvh = ctx->model->bvh;
+	return TrianglePack_occluded(ctx->model->pack, (int)(triangles - bvh->primitives), count, ray, ctx->tMin, *tMax);
+}
+
+bool Model_occluded(Model *model, Ray *ray, float tMin, float tMax){
+	if(model->type == SPHERE || model->type == LIGHT){
+		return Sphere_occluded(model, ray, tMin, tMax);
+	}
+	MeshOcclusionContext ctx;
+	ctx.model = model;
+	ctx.tMin = tMin;
+	return BVH_occluded(model->bvh, ray, tMax, Mesh_leafOcclusion, &ctx);
+}
+
+typedef struct{
+	Scene *scene;
+	Model *ignore;
+	float tMin;
+}SceneOcclusionContext;
+
+bool Scene_leafOcclusion(void *context, const int *models, int count, Ray *ray, float *tMax){
+	SceneOcclusionContext *ctx = (SceneOcclusionContext*)context;
+	const SpherePool *pool = ctx->scene->occluderSpheres;
+	int first = (int)(models - ctx->scene->occluderBVH->primitives);
+
+	STATS_MODEL_START();
+	bool blocked = SpherePool_occluded(pool, first, count, ray, ctx->tMin, *tMax, ctx->ignore);
+	STATS_SPHERES_STOP(pool, models, first, count);
+	if(blocked) return true;
+	for(int i = 0; i < count; i++){
+		if(SpherePool_isSphere(pool, first + i)) continue;
+		Model *model = pool->models[first + i];
+		if(model == ctx->ignore) continue;
+		STATS_MODEL_START();
+		bool occluded = Model_occluded(model, ray, ctx->tMin, *tMax);
+		STATS_MODEL_STOP(models[i]);
+		if(occluded) return true;
+	}
+	return false;
+}
+
+/**
+ * Any-hit query on the segment [tMin, tMax] of the ray, traversing only the models that cast shadows.
+ * It returns at the first blocker found, the model `ignore` is never considered a blocker.
+ */
+bool Scene_occluded(Scene *scene, Ray *ray, float tMin, float tMax, Model *ignore){
+	SceneOcclusionContext ctx;
+	ctx.scene = scene;
+	ctx.ignore = ignore;
+	ctx.tMin = tMin;
+	return BVH_occluded(scene->occluderBVH, ray, tMax, Scene_leafOcclusion, &ctx);
+}
@@ -0,0 +1,547 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include<string.h>
+#include"utils.h"
+#include"renderer.h"
+#include"raytracer.h"
+#include"trace.h"
+
+Renderer *Renderer_new(ThreadPool *pool){
+	Renderer *renderer = malloc(sizeof(Renderer));
+	if(renderer == NULL){
+		printf("ERROR::RENDERER::Renderer_new::Failed to allocate memory for Renderer\n");
+		return NULL;
+	}
+	renderer->countersMemory = calloc(pool->numWorkers + 1, sizeof(WorkerCounters));
+	if(renderer->countersMemory == NULL){
+		printf("ERROR::RENDERER::Renderer_new::Failed to allocate memory for worker counters\n");
+		free(renderer);
+		return NULL;
+	}
+	uintptr_t address = (uintptr_t)renderer->countersMemory;
+	renderer->counters = (WorkerCounters*)((address + RENDERER_CACHE_LINE - 1) & ~(uintptr_t)(RENDERER_CACHE_LINE - 1));
+	renderer->pool = pool;
+	renderer->order = RENDER_ORDER_TILES;
+	renderer->mode = RENDER_MODE_COLOR;
+	renderer->packets = true;
+	renderer->scene = NULL;
+	renderer->pixels = NULL;
+	renderer->width = 0;
+	renderer->height = 0;
+	renderer->pitch = 0;
+	renderer->antiAliasingFactor = 1;
+	renderer->blockSize = 1;
+	renderer->tiles.order = NULL;
+	renderer->tiles.numTiles = 0;
+	renderer->tiles.width = 0;
+	renderer->tiles.height = 0;
+	renderer->contrastThreshold = RENDERER_CONTRAST_THRESHOLD;
+	renderer->base = NULL;
+	renderer->baseCapacity = 0;
+	renderer->baseGeneration = 0;
+	renderer->baseWidth = 0;
+	renderer->baseHeight = 0;
+	renderer->adaptive = false;
+	renderer->costs = NULL;
+	renderer->costsCapacity = 0;
+	renderer->maxCost = 0;
+	renderer->samples = NULL;
+	renderer->samplesCapacity = 0;
+	atomic_init(&renderer->generation, 0);
+	renderer->frameGeneration = 0;
+	renderer->frame = 0;
+	return renderer;
+}
+
+/**
+ * Offset along the right vector of the camera of the column i of the supersampled image, in sub-pixel units.
+ */
+static Vector ColumnOffset(const Renderer *renderer, float i){
+	int width = renderer->width * renderer->antiAliasingFactor;
+	float dx = (i/width - 0.5) * renderer->viewportWidth;
+	return Vector_scale(renderer->scene->camera->right, dx);
+}
+
+/**
+ * Offset along the up vector of the camera of the row j of the supersampled image.
+ */
+static Vector RowOffset(const Renderer *renderer, float j){
+	int height = renderer->height * renderer->antiAliasingFactor;
+	float dy = (0.5 - j/height) * renderer->viewportHeight;
+	return Vector_scale(renderer->scene->camera->up, dy);
+}
+
+/**
+ * Computes the color seen through the point (i, j) of the supersampled image, in sub-pixel units.
+ */
+static Color GetPixelColor(const Renderer *renderer, float i, float j, Sampler *sampler, RayCounters *counters){
+	Camera *camera = renderer->scene->camera;
+	// the pixel lies at position + front + dx*right + dy*up, so the ray direction needs no intermediate point
+	Vector direction = camera->front;
+	direction = Vector_sum(direction, ColumnOffset(renderer, i));
+	direction = Vector_sum(direction, RowOffset(renderer, j));
+	Ray ray = Line_init(*camera->position, direction);
+
+	return TraceRay(renderer->scene, &ray, sampler, counters);
+}
+
+static inline bool IsCancelled(const Renderer *renderer){
+	return atomic_load_explicit((atomic_uint*)&renderer->generation, memory_order_relaxed) != renderer->frameGeneration;
+}
+
+/**
+ * Checks whether the single sample of a pixel contrasts with the one of a neighbour.
+ */
+static bool NeedsSupersampling(const Renderer *renderer, int x, int y){
+	int width = renderer->width;
+	Color center = Color_new(renderer->base[y * width + x]);
+	int minX = x > 0 ? x - 1 : x;
+	int maxX = x < width - 1 ? x + 1 : x;
+	int minY = y > 0 ? y - 1 : y;
+	int maxY = y < renderer->height - 1 ? y + 1 : y;
+
+	for(int j = minY; j <= maxY; j++){
+		for(int i = minX; i <= maxX; i++){
+			if(Color_difference(center, Color_new(renderer->base[j * width + i])) >= renderer->contrastThreshold) return true;
+		}
+	}
+	return false;
+}
+
+static void ShadePixel(const Renderer *renderer, int x, int y, int worker){
+	int factor = renderer->antiAliasingFactor;
+	uint32_t *base = renderer->base + y * renderer->width + x;
+	uint32_t *pixel = renderer->pixels + y * renderer->pitch + x;
+	RayCounters *counters = &renderer->counters[worker].rays;
+	Sampler sampler;
+	Sampler_init(&sampler, x, y, renderer->frame);
+
+	if(factor == 1){
+		*base = Color_extract(GetPixelColor(renderer, x + 0.5f, y + 0.5f, &sampler, counters));
+		*pixel = *base;
+		return;
+	}
+	// flat areas keep their single sample, the rays are spent on edges, highlights and penumbrae
+	if(renderer->adaptive && !NeedsSupersampling(renderer, x, y)){
+		*pixel = *base;
+		return;
+	}
+
+	int i = x * factor;
+	int j = y * factor;
+	Color *colors = renderer->samples + worker * factor * factor;
+	// sub-pixel positions along a scrambled Sobol sequence, stratified over the pixel
+	uint32_t seed = Sampler_nextUInt(&sampler);
+	int numSamples = factor * factor;
+	for(int s = 0; s < numSamples; s++){
+		float u, v;
+		Sampler_sobol2D(s, seed, &u, &v);
+		colors[s] = GetPixelColor(renderer, i + u * factor, j + v * factor, &sampler, counters);
+	}
+	*pixel = Color_extract(Color_average(colors, factor*factor));
+}
+
+/**
+ * Work done by a worker so far, in the unit of the heatmap mode of the renderer.
+ */
+static double WorkerCost(const Renderer *renderer, int worker){
+	const RayCounters *rays = &renderer->counters[worker].rays;
+	switch(renderer->mode){
+		case RENDER_MODE_HEATMAP_RAYS:
+			return rays->primary + rays->shadow + rays->reflection;
+		case RENDER_MODE_HEATMAP_TESTS:
+			return Stats_threadCounter(STAT_TRIANGLE_TESTS) + Stats_threadCounter(STAT_SPHERE_TESTS);
+		case RENDER_MODE_HEATMAP_TIME:
+			return GetTimeMs() * 1000;
+		default:
+			return 0;
+	}
+}
+
+static void RenderPixel(const Renderer *renderer, int x, int y, int worker){
+	if(renderer->mode == RENDER_MODE_COLOR){
+		ShadePixel(renderer, x, y, worker);
+		return;
+	}
+	double before = WorkerCost(renderer, worker);
+	ShadePixel(renderer, x, y, worker);
+	float cost = WorkerCost(renderer, worker) - before;
+	// the supersampling stage adds its cost to the one of the single sample
+	float *pixelCost = renderer->costs + y * renderer->width + x;
+	*pixelCost = renderer->adaptive ? *pixelCost + cost : cost;
+}
+
+/**
+ * Traces a single ray through the center of a block of pixels and fills the block with its color.
+ */
+static void RenderBlock(const Renderer *renderer, int x, int y, int width, int height, int worker){
+	double before = renderer->mode != RENDER_MODE_COLOR ? WorkerCost(renderer, worker) : 0;
+	Sampler sampler;
+	Sampler_init(&sampler, x, y, renderer->frame);
+	Color color = GetPixelColor(renderer, x + width * 0.5f, y + height * 0.5f, &sampler, &renderer->counters[worker].rays);
+	uint32_t value = Color_extract(color);
+	for(int j = y; j < y + height; j++){
+		uint32_t *row = renderer->pixels + j * renderer->pitch;
+		for(int i = x; i < x + width; i++){
+			row[i] = value;
+		}
+	}
+	if(renderer->mode == RENDER_MODE_COLOR) return;
+	float cost = WorkerCost(renderer, worker) - before;
+	for(int j = y; j < y + height; j++){
+		for(int i = x; i < x + width; i++){
+			renderer->costs[j * renderer->width + i] = cost;
+		}
+	}
+}
+
+/**
+ * Renders the cells of 8 consecutive Morton codes of a tile with a packet of rays, one through the center of each cell.
+ * The cells are pixels or, in a preview pass, blocks of pixels filled with the color of their ray.
+ */
+static void RenderPacket(const Renderer *renderer, const Tile *tile, uint32_t firstCode, int worker){
+	Camera *camera = renderer->scene->camera;
+	int block = renderer->blockSize;
+	uint32_t firstX, firstY;
+	Morton_decode(firstCode, &firstX, &firstY);
+	int left = tile->x + firstX * block;
+	int top = tile->y + firstY * block;
+
+	// the offsets of the columns and the rows of the packet are shared by its rays
+	Vector columns[PACKET_WIDTH], rows[PACKET_HEIGHT];
+	int widths[PACKET_WIDTH], heights[PACKET_HEIGHT];
+	for(int c = 0; c < PACKET_WIDTH; c++){
+		int x = (firstX + c) * block;
+		widths[c] = x + block <= tile->width ? block : tile->width - x;
+		columns[c] = ColumnOffset(renderer, tile->x + x + widths[c] * 0.5f);
+	}
+	for(int r = 0; r < PACKET_HEIGHT; r++){
+		int y = (firstY + r) * block;
+		heights[r] = y + block <= tile->height ? block : tile->height - y;
+		rows[r] = RowOffset(renderer, tile->y + y + heights[r] * 0.5f);
+	}
+
+	Vector directions[PACKET_SIZE];
+	Sampler samplers[PACKET_SIZE];
+	int cellX[PACKET_SIZE], cellY[PACKET_SIZE], column[PACKET_SIZE], row[PACKET_SIZE];
+	uint32_t active = 0;
+	for(int i = 0; i < PACKET_SIZE; i++){
+		uint32_t x, y;
+		Morton_decode(firstCode + i, &x, &y);
+		column[i] = x - firstX;
+		row[i] = y - firstY;
+		cellX[i] = x * block;
+		cellY[i] = y * block;
+		directions[i] = Vector_sum(Vector_sum(camera->front, columns[column[i]]), rows[row[i]]);
+		if(cellX[i] >= tile->width || cellY[i] >= tile->height) continue;
+		active |= 1u << i;
+		cellX[i] += tile->x;
+		cellY[i] += tile->y;
+		Sampler_init(&samplers[i], cellX[i], cellY[i], renderer->frame);
+	}
+
+	// the edges of the cells around the packet bound its frustum
+	Vector leftOffset = ColumnOffset(renderer, left);
+	Vector rightOffset = ColumnOffset(renderer, left + PACKET_WIDTH * block);
+	Vector topOffset = RowOffset(renderer, top);
+	Vector bottomOffset = RowOffset(renderer, top + PACKET_HEIGHT * block);
+	Vector corners[4] = {
+		Vector_sum(Vector_sum(camera->front, leftOffset), topOffset),
+		Vector_sum(Vector_sum(camera->front, rightOffset), topOffset),
+		Vector_sum(Vector_sum(camera->front, rightOffset), bottomOffset),
+		Vector_sum(Vector_sum(camera->front, leftOffset), bottomOffset)
+	};
+	RayPacket packet;
+	RayPacket_init(&packet, *camera->position, directions, corners);
+
+	Color colors[PACKET_SIZE];
+	TracePacket(renderer->scene, &packet, active, samplers, &renderer->counters[worker].rays, colors);
+	for(int i = 0; i < PACKET_SIZE; i++){
+		if(!(active & (1u << i))) continue;
+		uint32_t value = Color_extract(colors[i]);
+		if(block == 1){
+			renderer->base[cellY[i] * renderer->width + cellX[i]] = value;
+			renderer->pixels[cellY[i] * renderer->pitch + cellX[i]] = value;
+			continue;
+		}
+		for(int j = cellY[i]; j < cellY[i] + heights[row[i]]; j++){
+			uint32_t *pixels = renderer->pixels + j * renderer->pitch;
+			for(int x = cellX[i]; x < cellX[i] + widths[column[i]]; x++) pixels[x] = value;
+		}
+	}
+}
+
+/**
+ * Maps a value in [0, 1] to a black, purple, orange, yellow color ramp.
+ */
+static Color HeatColor(float value){
+	static const float stops[][3] = {{0, 0, 0}, {0.34f, 0.06f, 0.43f}, {0.73f, 0.21f, 0.33f}, {0.98f, 0.55f, 0.04f}, {0.99f, 1, 0.64f}};
+	int numStops = sizeof(stops) / sizeof(stops[0]);
+	float position = value * (numStops - 1);
+	int i = (int)position;
+	if(i >= numStops - 1) return Color_fromRGB(stops[numStops - 1][0], stops[numStops - 1][1], stops[numStops - 1][2]);
+	if(i < 0) i = 0;
+	Color a = Color_fromRGB(stops[i][0], stops[i][1], stops[i][2]);
+	Color b = Color_fromRGB(stops[i + 1][0], stops[i + 1][1], stops[i + 1][2]);
+	return Color_blend(a, b, position - i);
+}
+
+/**
+ * Replaces the colors of the frame with its cost heatmap, on a logarithmic scale up to the most expensive pixel.
+ */
+static void WriteHeatmap(Renderer *renderer){
+	float maxCost = 0;
+	for(int i = 0; i < renderer->width * renderer->height; i++){
+		if(renderer->costs[i] > maxCost) maxCost = renderer->costs[i];
+	}
+	renderer->maxCost = maxCost;
+	float scale = maxCost > 0 ? 1 / logf(1 + maxCost) : 0;
+	for(int y = 0; y < renderer->height; y++){
+		const float *costs = renderer->costs + y * renderer->width;
+		uint32_t *row = renderer->pixels + y * renderer->pitch;
+		for(int x = 0; x < renderer->width; x++){
+			row[x] = Color_extract(HeatColor(logf(1 + costs[x]) * scale));
+		}
+	}
+}
+
+static void RenderTile(void *context, int task, int worker){
+	Renderer *renderer = (Renderer*)context;
+	double start = GetTimeMs();
+	PERF_BEGIN(PERF_STAGE_RENDER);
+	Tile tile = TileGrid_getTile(&renderer->tiles, task);
+	int block = renderer->blockSize;
+
+	// neighbouring pixels share most of their BVH path, so the tile is walked along a Morton curve as well
+	int size = renderer->tiles.tileSize / block;
+	// the single samples of a color pass are traced by packets of 8 cells, the others need the cost or the samples of each pixel
+	bool packets = renderer->packets && renderer->mode == RENDER_MODE_COLOR && renderer->antiAliasingFactor == 1;
+	for(uint32_t code = 0; code < (uint32_t)size * size; code += packets ? PACKET_SIZE : 1){
+		if(packets){
+			if(IsCancelled(renderer)) break;
+			RenderPacket(renderer, &tile, code, worker);
+			continue;
+		}
+		uint32_t dx, dy;
+		Morton_decode(code, &dx, &dy);
+		int x = dx * block;
+		int y = dy * block;
+		if(x >= tile.width || y >= tile.height) continue;
+		if(IsCancelled(renderer)) break;
+
+		if(block == 1){
+			RenderPixel(renderer, tile.x + x, tile.y + y, worker);
+		}
+		else{
+			int width = x + block <= tile.width ? block : tile.width - x;
+			int height = y + block <= tile.height ? block : tile.height - y;
+			RenderBlock(renderer, tile.x + x, tile.y + y, width, height, worker);
+		}
+	}
+	PERF_END();
+	double end = GetTimeMs();
+	renderer->counters[worker].busyTime += end - start;
+	Stats_flush(&renderer->counters[worker].stats);
+	Stats_flushModelCosts(&renderer->counters[worker].models);
+	Perf_flush(&renderer->counters[worker].perf);
+	Trace_complete("tile", worker, start, end, "tile", task);
+}
+
+static void RenderColumn(void *context, int task, int worker){
+	Renderer *renderer = (Renderer*)context;
+	double start = GetTimeMs();
+	PERF_BEGIN(PERF_STAGE_RENDER);
+	for(int y = 0; y < renderer->height; y++){
+		if(IsCancelled(renderer)) break;
+		RenderPixel(renderer, task, y, worker);
+	}
+	PERF_END();
+	double end = GetTimeMs();
+	renderer->counters[worker].busyTime += end - start;
+	Stats_flush(&renderer->counters[worker].stats);
+	Stats_flushModelCosts(&renderer->counters[worker].models);
+	Perf_flush(&renderer->counters[worker].perf);
+	Trace_complete("column", worker, start, end, "column", task);
+}
+
+/**
+ * Runs the tasks of a pass on the pool with the current settings of the renderer.
+ *
+ * @return 0 in case of success, RENDERER_CANCELLED if the frame was cancelled, -1 if the pool could not run the tasks.
+ */
+static int RunPass(Renderer *renderer){
+	double start = GetTimeMs();
+	int result;
+	if(renderer->order == RENDER_ORDER_COLUMNS){
+		result = ThreadPool_run(renderer->pool, renderer->width, RenderColumn, renderer);
+	}
+	else{
+		result = ThreadPool_run(renderer->pool, renderer->tiles.numTiles, RenderTile, renderer);
+	}
+	if(result != 0){
+		printf("ERROR::RENDERER::RunPass::Failed to run the tasks of the pass\n");
+		return -1;
+	}
+	if(Trace_enabled()){
+		const char *name = renderer->blockSize > 1 ? "preview pass" : renderer->adaptive ? "supersampling pass" : "pass";
+		Trace_complete(name, TRACE_THREAD_RENDER, start, GetTimeMs(), "index", renderer->frame);
+	}
+	return IsCancelled(renderer) ? RENDERER_CANCELLED : 0;
+}
+
+int Renderer_render(Renderer *renderer, Scene *scene, uint32_t *pixels, int width, int height, int pitch, int antiAliasingFactor){
+	RenderPass pass = {1, antiAliasingFactor, false};
+	return Renderer_renderPass(renderer, scene, pixels, width, height, pitch, pass);
+}
+
+int Renderer_renderPass(Renderer *renderer, Scene *scene, uint32_t *pixels, int width, int height, int pitch, RenderPass pass){
+	if(renderer == NULL || scene == NULL || pixels == NULL || width <= 0 || height <= 0) return -1;
+	int block = 1;
+	while(block < pass.blockSize && block < RENDERER_TILE_SIZE) block <<= 1;
+	int factor = pass.antiAliasingFactor < 1 || block > 1 ? 1 : pass.antiAliasingFactor;
+
+	if(renderer->tiles.order == NULL || renderer->tiles.width != width || renderer->tiles.height != height){
+		TileGrid_free(&renderer->tiles);
+		if(TileGrid_init(&renderer->tiles, width, height, RENDERER_TILE_SIZE) != 0) return -1;
+	}
+
+	int samplesNeeded = renderer->pool->numWorkers * factor * factor;
+	if(samplesNeeded > renderer->samplesCapacity){
+		Color *samples = realloc(renderer->samples, samplesNeeded * sizeof(Color));
+		if(samples == NULL){
+			printf("ERROR::RENDERER::Renderer_renderPass::Failed to allocate memory for sample buffer\n");
+			return -1;
+		}
+		renderer->samples = samples;
+		renderer->samplesCapacity = samplesNeeded;
+	}
+	if(width * height > renderer->baseCapacity){
+		uint32_t *base = realloc(renderer->base, width * height * sizeof(uint32_t));
+		if(base == NULL){
+			printf("ERROR::RENDERER::Renderer_renderPass::Failed to allocate memory for base buffer\n");
+			return -1;
+		}
+		renderer->base = base;
+		renderer->baseCapacity = width * height;
+	}
+	if(renderer->mode != RENDER_MODE_COLOR && width * height > renderer->costsCapacity){
+		float *costs = realloc(renderer->costs, width * height * sizeof(float));
+		if(costs == NULL){
+			printf("ERROR::RENDERER::Renderer_renderPass::Failed to allocate memory for cost buffer\n");
+			return -1;
+		}
+		renderer->costs = costs;
+		renderer->costsCapacity = width * height;
+	}
+
+	renderer->scene = scene;
+	renderer->pixels = pixels;
+	renderer->width = width;
+	renderer->height = height;
+	renderer->pitch = pitch;
+	renderer->blockSize = renderer->order == RENDER_ORDER_COLUMNS ? 1 : block;
+	renderer->viewportWidth = 2 * tan(scene->camera->fov / 2);
+	renderer->viewportHeight = renderer->viewportWidth * height / width;
+	renderer->frameGeneration = atomic_load(&renderer->generation);
+	renderer->frame++;
+	renderer->adaptive = false;
+
+	if(factor > 1 && renderer->contrastThreshold > 0){
+		bool reuse = pass.refine && renderer->baseGeneration == renderer->frameGeneration &&
+			renderer->baseWidth == width && renderer->baseHeight == height;
+		if(!reuse){
+			renderer->antiAliasingFactor = 1;
+			int result = RunPass(renderer);
+			if(result != 0) return result;
+		}
+		renderer->adaptive = true;
+	}
+	renderer->antiAliasingFactor = factor;
+	int result = RunPass(renderer);
+	if(result != 0) return result;
+	if(renderer->mode != RENDER_MODE_COLOR) WriteHeatmap(renderer);
+
+	if(factor == 1 && renderer->blockSize == 1){
+		renderer->baseGeneration = renderer->frameGeneration;
+		renderer->baseWidth = width;
+		renderer->baseHeight = height;
+	}
+	return 0;
+}
+
+int Renderer_progressivePasses(int antiAliasingFactor, RenderPass *passes){
+	int numPasses = 0;
+	passes[numPasses++] = (RenderPass){RENDERER_PREVIEW_BLOCK_SIZE, 1, false};
+	passes[numPasses++] = (RenderPass){1, 1, false};
+	if(antiAliasingFactor > 1) passes[numPasses++] = (RenderPass){1, antiAliasingFactor, true};
+	return numPasses;
+}
+
+void Renderer_cancel(Renderer *renderer){
+	atomic_fetch_add(&renderer->generation, 1);
+}
+
+RayCounters Renderer_rayCounters(const Renderer *renderer){
+	RayCounters rays = {0, 0, 0};
+	for(int i = 0; i < renderer->pool->numWorkers; i++){
+		rays.primary += renderer->counters[i].rays.primary;
+		rays.shadow += renderer->counters[i].rays.shadow;
+		rays.reflection += renderer->counters[i].rays.reflection;
+	}
+	return rays;
+}
+
+RenderStats Renderer_stats(const Renderer *renderer){
+	RenderStats stats;
+	Stats_reset(&stats);
+	for(int i = 0; i < renderer->pool->numWorkers; i++){
+		Stats_merge(&stats, &renderer->counters[i].stats);
+	}
+	return stats;
+}
+
+int Renderer_modelCosts(const Renderer *renderer, ModelCosts *costs){
+	for(int i = 0; i < renderer->pool->numWorkers; i++){
+		const ModelCosts *models = &renderer->counters[i].models;
+		for(int j = 0; j < models->count; j++){
+			if(models->costs[j].queries == 0) continue;
+			if(Stats_addModelCost(costs, j, models->costs[j].queries, models->costs[j].time) != 0) return -1;
+		}
+	}
+	return 0;
+}
+
+PerfStages Renderer_perf(const Renderer *renderer, int worker){
+	if(worker >= 0 && worker < renderer->pool->numWorkers) return renderer->counters[worker].perf;
+	PerfStages perf;
+	Perf_reset(&perf);
+	for(int i = 0; i < renderer->pool->numWorkers; i++){
+		Perf_merge(&perf, &renderer->counters[i].perf);
+	}
+	return perf;
+}
+
+void Renderer_resetCounters(Renderer *renderer){
+	for(int i = 0; i < renderer->pool->numWorkers; i++){
+		WorkerCounters *counters = &renderer->counters[i];
+		memset(&counters->rays, 0, sizeof(RayCounters));
+		counters->busyTime = 0;
+		Stats_reset(&counters->stats);
+		Stats_resetModelCosts(&counters->models);
+		Perf_reset(&counters->perf);
+	}
+}
+
+void Renderer_free(Renderer *renderer){
+	if(renderer == NULL) return;
+	for(int i = 0; i < renderer->pool->numWorkers; i++){
+		Stats_freeModelCosts(&renderer->counters[i].models);
+	}
+	free(renderer->countersMemory);
+	free(renderer->costs);
+	TileGrid_free(&renderer->tiles);
+	free(renderer->samples);
+	free(renderer->base);
+	free(renderer);
+}
@@ -0,0 +1,58 @@
+#include"sampler.h"
+
+// SplitMix64 finalizer, turns neighbouring keys into unrelated seeds
+static uint64_t Mix(uint64_t key){
+	key += 0x9E3779B97F4A7C15ULL;
+	key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+	return key ^ (key >> 31);
+}
+
+void Sampler_init(Sampler *sampler, uint32_t x, uint32_t y, uint32_t frame){
+	uint64_t key = ((uint64_t)y << 32 | x) ^ Mix(frame);
+	sampler->state = 0;
+	sampler->increment = (Mix(key ^ 0xDA942042E4DD58B5ULL) << 1) | 1;
+	Sampler_nextUInt(sampler);
+	sampler->state += Mix(key);
+	Sampler_nextUInt(sampler);
+}
+
+static inline uint32_t ReverseBits(uint32_t x){
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+	x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// hash-based Owen scrambling (Laine-Karras permutation applied to the reversed bits):
+// flips every bit depending only on the bits above it, which preserves the stratification of the sequence
+static inline uint32_t OwenScramble(uint32_t x, uint32_t seed){
+	x = ReverseBits(x);
+	x += seed;
+	x ^= x * 0x6C50B47Cu;
+	x ^= x * 0xB82F1E52u;
+	x ^= x * 0xC7AFE638u;
+	x ^= x * 0x8D22F6E6u;
+	return ReverseBits(x);
+}
+
+static inline uint32_t HashSeed(uint32_t seed, uint32_t dimension){
+	return (uint32_t)Mix(((uint64_t)seed << 32) | dimension);
+}
+
+void Sampler_sobol2D(uint32_t index, uint32_t seed, float *u, float *v){
+	// first dimension: van der Corput sequence, second dimension: generated by x + 1
+	uint32_t x = ReverseBits(index);
+	uint32_t y = 0;
+	uint32_t direction = 1u << 31;
+	for(uint32_t bits = index; bits != 0; bits >>= 1){
+		if(bits & 1) y ^= direction;
+		direction ^= direction >> 1;
+	}
+
+	x = OwenScramble(x, HashSeed(seed, 0));
+	y = OwenScramble(y, HashSeed(seed, 1));
+	*u = (x >> 8) * 0x1p-24f;
+	*v = (y >> 8) * 0x1p-24f;
+}
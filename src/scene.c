@@ -1,8 +1,9 @@
 #include"scene.h"
 #include<math.h>
+#include<stdbool.h>
 
 Scene *Scene_init(Camera *camera){
-	Scene *s = malloc(sizeof(Scene*));
+	Scene *s = malloc(sizeof(Scene));
 	if(s == NULL){
 		printf("ERROR::SCENE::Scene_init::Memory allocation failed.\n");
 		return NULL;
@@ -11,6 +12,10 @@ Scene *Scene_init(Camera *camera){
 	s->models = NULL;;
 	s->camera = camera;
 	s->lightSource = NULL;
+	s->bvh = NULL;
+	s->occluderBVH = NULL;
+	s->spheres = NULL;
+	s->occluderSpheres = NULL;
 	return s;
 }
 
@@ -23,7 +28,7 @@ void Scene_fill(Scene *s, Light *lightSource, Model **models, int numModels){
 	if(models == NULL){
 		s->numModels = 1;
 	}
-	s->models = malloc((s->numModels) * sizeof(Model));
+	s->models = malloc((s->numModels) * sizeof(Model*));
 	for(int i = 0; i < s->numModels - 1; i++){
 		s->models[i] = models[i];
 	}
@@ -32,7 +37,7 @@ void Scene_fill(Scene *s, Light *lightSource, Model **models, int numModels){
 	s->models[s->numModels - 1] = Model_createSphere(lightSource->position, lightSource->radius, lightMaterial);
 	s->models[s->numModels - 1]->type = LIGHT;
 
-	Scene_sortModels(s);
+	Scene_buildBVH(s);
 }
 
 void Scene_addModels(Scene *s, Model **models, int numModels){
@@ -50,7 +55,7 @@ void Scene_addModels(Scene *s, Model **models, int numModels){
 	free(s->models);
 	s->numModels = totModels;
 	s->models = newModels;
-	Scene_sortModels(s);
+	Scene_buildBVH(s);
 }
 
 void Scene_sortModels(Scene *s){
@@ -67,6 +72,66 @@ void Scene_sortModels(Scene *s){
 		s->models[i] = s->models[min];
 		s->models[min] = tmp;
 	}
+	if(s->bvh != NULL) Scene_buildBVH(s);
+}
+
+BVH *BuildModelBVH(Scene *s, bool includeLights){
+	AABB *bounds = malloc(s->numModels * sizeof(AABB));
+	int *modelIndices = malloc(s->numModels * sizeof(int));
+	if(bounds == NULL || modelIndices == NULL){
+		printf("ERROR::SCENE::BuildModelBVH::Failed to allocate memory for model bounds\n");
+		free(bounds);
+		free(modelIndices);
+		return NULL;
+	}
+	int numBounds = 0;
+	for(unsigned int i = 0; i < s->numModels; i++){
+		if(s->models[i] == NULL) continue;
+		if(!includeLights && s->models[i]->type == LIGHT) continue;
+		bounds[numBounds] = Model_getBounds(s->models[i]);
+		modelIndices[numBounds++] = i;
+	}
+	BVH *bvh = BVH_build(bounds, numBounds, SCENE_BVH_LEAF_SIZE);
+	if(bvh != NULL){
+		// BVH primitives refer to the filtered array, map them back to scene->models
+		for(int i = 0; i < bvh->numPrimitives; i++){
+			bvh->primitives[i] = modelIndices[bvh->primitives[i]];
+		}
+	}
+	free(modelIndices);
+	free(bounds);
+	return bvh;
+}
+
+/**
+ * Gathers the models of a top-level BVH in the order of its primitives, so that every leaf is a range of the pool.
+ */
+SpherePool *BuildSpherePool(Scene *s, const BVH *bvh){
+	if(bvh == NULL) return NULL;
+	SpherePool *pool = SpherePool_new(bvh->numPrimitives);
+	if(pool == NULL) return NULL;
+	for(int i = 0; i < bvh->numPrimitives; i++){
+		SpherePool_set(pool, i, s->models[bvh->primitives[i]]);
+	}
+	return pool;
+}
+
+void Scene_buildBVH(Scene *s){
+	if(s == NULL) return;
+	BVH_free(s->bvh);
+	BVH_free(s->occluderBVH);
+	SpherePool_free(s->spheres);
+	SpherePool_free(s->occluderSpheres);
+	s->bvh = NULL;
+	s->occluderBVH = NULL;
+	s->spheres = NULL;
+	s->occluderSpheres = NULL;
+	if(s->numModels == 0) return;
+
+	s->bvh = BuildModelBVH(s, true);
+	s->occluderBVH = BuildModelBVH(s, false);
+	s->spheres = BuildSpherePool(s, s->bvh);
+	s->occluderSpheres = BuildSpherePool(s, s->occluderBVH);
 }
 
 Light *Light_new(Point *position, float radius, Color lightColor){
@@ -78,6 +143,9 @@ Light *Light_new(Point *position, float radius, Color lightColor){
 	light->constant = 1;
 	light->linear = 0;
 	light->quadratic = 0;
+
+	light->shadowSamples = LIGHT_DEFAULT_SHADOW_SAMPLES;
+	light->shadowThreshold = LIGHT_DEFAULT_SHADOW_THRESHOLD;
 	return light;
 }
 
@@ -88,6 +156,12 @@ void Light_setAttenuation(Light *light, float constant, float linear, float quad
 	light->quadratic = quadratic;
 }
 
+void Light_setShadowSampling(Light *light, int maxSamples, float threshold){
+	if(light == NULL) return;
+	light->shadowSamples = maxSamples < 1 ? 1 : maxSamples;
+	light->shadowThreshold = threshold < 0 ? 0 : threshold;
+}
+
 size_t Light_size(Light *light){
 	size_t size = sizeof(*light);
 	size += Point_size(light->position);
@@ -100,6 +174,10 @@ size_t Scene_size(Scene *s){
 	size += Light_size(s->lightSource);
 	size += Camera_size(s->camera);
 	size += s->numModels * sizeof(*s->models);
+	size += BVH_size(s->bvh);
+	size += BVH_size(s->occluderBVH);
+	size += SpherePool_size(s->spheres);
+	size += SpherePool_size(s->occluderSpheres);
 	for(int i = 0; i < s->numModels; i++){
 		size += Model_size(s->models[i]);
 	}
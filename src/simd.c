@@ -0,0 +1,68 @@
+#include<stdio.h>
+#include"simd.h"
+
+SimdLevel simdLevel = SIMD_SCALAR;
+
+static bool levelSelected = false;
+
+static const char *levelNames[SIMD_NUM_LEVELS] = {"scalar", "sse4.1", "avx2"};
+
+#if SIMD_X86 && !defined(__GNUC__) && !defined(__clang__)
+/**
+ * Reads the features from cpuid, AVX also needs the OS to save the YMM registers (XCR0 bits 1 and 2).
+ */
+static bool CpuSupports(SimdLevel level){
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse41 = (info[2] >> 19) & 1;
+	bool avx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+	bool avx2 = false;
+	if(avx && maxLeaf >= 7){
+		__cpuidex(info, 7, 0);
+		avx2 = (info[1] >> 5) & 1;
+	}
+	return level == SIMD_SSE41 ? sse41 : avx2;
+}
+#endif
+
+bool Simd_supported(SimdLevel level){
+	if(level == SIMD_SCALAR) return true;
+	if(level >= SIMD_NUM_LEVELS) return false;
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	return level == SIMD_SSE41 ? __builtin_cpu_supports("sse4.1") : __builtin_cpu_supports("avx2");
+#elif SIMD_X86
+	return CpuSupports(level);
+#else
+	return false;
+#endif
+}
+
+int Simd_setLevel(SimdLevel level){
+	if(!Simd_supported(level)){
+		printf("ERROR::SIMD::Simd_setLevel::Level %s is not supported\n", Simd_levelName(level));
+		return -1;
+	}
+	simdLevel = level;
+	levelSelected = true;
+	return 0;
+}
+
+void Simd_init(){
+	if(levelSelected) return;
+	// AVX-512 machines run the AVX2 kernels, the packed structures are tested 8 lanes at a time
+	SimdLevel level = SIMD_NUM_LEVELS - 1;
+	while(!Simd_supported(level)) level--;
+	Simd_setLevel(level);
+}
+
+SimdLevel Simd_level(){
+	Simd_init();
+	return simdLevel;
+}
+
+const char *Simd_levelName(SimdLevel level){
+	return level < SIMD_NUM_LEVELS ? levelNames[level] : "unknown";
+}
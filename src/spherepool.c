@@ -0,0 +1,368 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include"spherepool.h"
+#include"simd.h"
+
+SpherePool *SpherePool_new(int count){
+	if(count <= 0) return NULL;
+	SpherePool *pool = malloc(sizeof(SpherePool));
+	int stride = count + SPHERE_POOL_WIDTH;
+	float *data = malloc(4 * (size_t)stride * sizeof(float));
+	Model **models = calloc(stride, sizeof(Model*));
+	if(pool == NULL || data == NULL || models == NULL){
+		printf("ERROR::SPHEREPOOL::SpherePool_new::Failed to allocate memory for the pool\n");
+		free(pool);
+		free(data);
+		free(models);
+		return NULL;
+	}
+	for(int axis = 0; axis < 3; axis++){
+		pool->center[axis] = data + axis * stride;
+	}
+	pool->radiusSquared = data + 3 * stride;
+	// padding lanes are never spheres
+	for(int i = 0; i < stride; i++){
+		pool->center[0][i] = pool->center[1][i] = pool->center[2][i] = 0;
+		pool->radiusSquared[i] = -INFINITY;
+	}
+	pool->models = models;
+	pool->count = count;
+	Simd_init();
+	return pool;
+}
+
+void SpherePool_set(SpherePool *pool, int i, Model *model){
+	pool->models[i] = model;
+	if(model->type != SPHERE && model->type != LIGHT){
+		// c becomes infinite, so does the opposite of the discriminant: the lane never hits
+		pool->radiusSquared[i] = -INFINITY;
+		return;
+	}
+	float r = fmax(0.1, model->boundingRadius);
+	pool->center[0][i] = model->center->x;
+	pool->center[1][i] = model->center->y;
+	pool->center[2][i] = model->center->z;
+	pool->radiusSquared[i] = r * r;
+}
+
+size_t SpherePool_size(const SpherePool *pool){
+	if(pool == NULL) return 0;
+	size_t stride = pool->count + SPHERE_POOL_WIDTH;
+	return sizeof(*pool) + stride * (4 * sizeof(float) + sizeof(Model*));
+}
+
+void SpherePool_free(SpherePool *pool){
+	if(pool == NULL) return;
+	free(pool->center[0]);
+	free(pool->models);
+	free(pool);
+}
+
+
+// ───── Scalar kernel ─────
+
+/**
+ * Closest hit test of the i-th sphere, written like Sphere_intersection. a is the squared norm of the direction.
+ */
+static bool IntersectOne(const SpherePool *pool, int i, const Line *ray, float a, float *distance){
+	Vector d = ray->direction;
+	float lx = ray->origin.x - pool->center[0][i];
+	float ly = ray->origin.y - pool->center[1][i];
+	float lz = ray->origin.z - pool->center[2][i];
+
+	float b = 2 * (lx*d.x + ly*d.y + lz*d.z);
+	float c = (lx*lx + ly*ly + lz*lz) - pool->radiusSquared[i];
+	float discriminant = b * b - 4 * a * c;
+	if(discriminant < 0) return false;
+
+	float sqrtDiscriminant = sqrtf(discriminant);
+	float t1 = (-b - sqrtDiscriminant) / (2 * a);
+	float t2 = (-b + sqrtDiscriminant) / (2 * a);
+	if(t1 > 0) *distance = t1;
+	else if(t2 > 0) *distance = t2;
+	else return false;
+	return true;
+}
+
+/**
+ * Occlusion test of the i-th sphere, written like Sphere_occluded.
+ */
+static bool OccludedOne(const SpherePool *pool, int i, const Line *ray, float tMin, float tMax){
+	Vector d = ray->direction;
+	float lx = ray->origin.x - pool->center[0][i];
+	float ly = ray->origin.y - pool->center[1][i];
+	float lz = ray->origin.z - pool->center[2][i];
+
+	float b = lx*d.x + ly*d.y + lz*d.z;
+	float c = (lx*lx + ly*ly + lz*lz) - pool->radiusSquared[i];
+	float discriminant = b * b - c;
+	if(discriminant < 0) return false;
+
+	float sqrtDiscriminant = sqrtf(discriminant);
+	float t1 = -b - sqrtDiscriminant;
+	float t2 = -b + sqrtDiscriminant;
+	return (t1 > tMin && t1 < tMax) || (t2 > tMin && t2 < tMax);
+}
+
+static int IntersectScalar(const SpherePool *pool, int first, int count, Line *ray, float *tMax){
+	float a = Vector_dot(ray->direction, ray->direction);
+	int best = -1;
+	for(int i = first; i < first + count; i++){
+		float t;
+		if(IntersectOne(pool, i, ray, a, &t) && t < *tMax){
+			*tMax = t;
+			best = i;
+		}
+	}
+	return best;
+}
+
+static bool OccludedScalar(const SpherePool *pool, int first, int count, Line *ray, float tMin, float tMax, const Model *ignore){
+	for(int i = first; i < first + count; i++){
+		if(pool->models[i] != ignore && OccludedOne(pool, i, ray, tMin, tMax)) return true;
+	}
+	return false;
+}
+
+#if SIMD_X86
+
+/**
+ * Returns true if one of the lanes of mask, relative to position base, is a sphere other than ignore.
+ */
+static bool AnyBlocker(const SpherePool *pool, int base, int mask, const Model *ignore){
+	for(int lane = 0; mask != 0; lane++, mask >>= 1){
+		if((mask & 1) && pool->models[base + lane] != ignore) return true;
+	}
+	return false;
+}
+
+
+// ───── SSE4.1 kernel, 4 spheres ─────
+
+/**
+ * Closest hit test of 4 consecutive spheres starting at i, see Test8.
+ */
+SIMD_TARGET("sse4.1")
+static inline __m128 Test4(const SpherePool *pool, int i, const __m128 o[3], const __m128 d[3], __m128 fourA, __m128 twoA, __m128 *distance){
+	__m128 lx = _mm_sub_ps(o[0], _mm_loadu_ps(pool->center[0] + i));
+	__m128 ly = _mm_sub_ps(o[1], _mm_loadu_ps(pool->center[1] + i));
+	__m128 lz = _mm_sub_ps(o[2], _mm_loadu_ps(pool->center[2] + i));
+
+	__m128 b = _mm_mul_ps(_mm_set1_ps(2), _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, d[0]), _mm_mul_ps(ly, d[1])), _mm_mul_ps(lz, d[2])));
+	__m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz)), _mm_loadu_ps(pool->radiusSquared + i));
+	__m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(fourA, c));
+	__m128 valid = _mm_cmpnlt_ps(discriminant, _mm_setzero_ps());
+
+	__m128 sqrtDiscriminant = _mm_sqrt_ps(discriminant);
+	__m128 minusB = _mm_xor_ps(b, _mm_set1_ps(-0.0f));
+	__m128 t1 = _mm_div_ps(_mm_sub_ps(minusB, sqrtDiscriminant), twoA);
+	__m128 t2 = _mm_div_ps(_mm_add_ps(minusB, sqrtDiscriminant), twoA);
+	__m128 front1 = _mm_cmpgt_ps(t1, _mm_setzero_ps());
+	__m128 front2 = _mm_cmpgt_ps(t2, _mm_setzero_ps());
+	*distance = _mm_blendv_ps(t2, t1, front1);
+	return _mm_and_ps(valid, _mm_or_ps(front1, front2));
+}
+
+/**
+ * Occlusion test of 4 consecutive spheres starting at i, see Occluded8.
+ */
+SIMD_TARGET("sse4.1")
+static inline __m128 Occluded4(const SpherePool *pool, int i, const __m128 o[3], const __m128 d[3], __m128 tMin, __m128 tMax){
+	__m128 lx = _mm_sub_ps(o[0], _mm_loadu_ps(pool->center[0] + i));
+	__m128 ly = _mm_sub_ps(o[1], _mm_loadu_ps(pool->center[1] + i));
+	__m128 lz = _mm_sub_ps(o[2], _mm_loadu_ps(pool->center[2] + i));
+
+	__m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, d[0]), _mm_mul_ps(ly, d[1])), _mm_mul_ps(lz, d[2]));
+	__m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, lx), _mm_mul_ps(ly, ly)), _mm_mul_ps(lz, lz)), _mm_loadu_ps(pool->radiusSquared + i));
+	__m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), c);
+	__m128 valid = _mm_cmpnlt_ps(discriminant, _mm_setzero_ps());
+
+	__m128 sqrtDiscriminant = _mm_sqrt_ps(discriminant);
+	__m128 minusB = _mm_xor_ps(b, _mm_set1_ps(-0.0f));
+	__m128 t1 = _mm_sub_ps(minusB, sqrtDiscriminant);
+	__m128 t2 = _mm_add_ps(minusB, sqrtDiscriminant);
+	__m128 in1 = _mm_and_ps(_mm_cmpgt_ps(t1, tMin), _mm_cmplt_ps(t1, tMax));
+	__m128 in2 = _mm_and_ps(_mm_cmpgt_ps(t2, tMin), _mm_cmplt_ps(t2, tMax));
+	return _mm_and_ps(valid, _mm_or_ps(in1, in2));
+}
+
+/**
+ * Mask of the first count lanes of a group of 4.
+ */
+SIMD_TARGET("sse4.1")
+static inline __m128 Lanes4(int count){
+	return _mm_castsi128_ps(_mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(count)));
+}
+
+SIMD_TARGET("sse4.1")
+static int IntersectSSE41(const SpherePool *pool, int first, int count, Line *ray, float *tMax){
+	float a = Vector_dot(ray->direction, ray->direction);
+	__m128 fourA = _mm_set1_ps(4 * a), twoA = _mm_set1_ps(2 * a);
+	__m128 o[3] = {_mm_set1_ps(ray->origin.x), _mm_set1_ps(ray->origin.y), _mm_set1_ps(ray->origin.z)};
+	__m128 d[3] = {_mm_set1_ps(ray->direction.x), _mm_set1_ps(ray->direction.y), _mm_set1_ps(ray->direction.z)};
+	int best = -1;
+	for(int base = 0; base < count; base += 4){
+		__m128 t;
+		__m128 valid = _mm_and_ps(Test4(pool, first + base, o, d, fourA, twoA, &t), Lanes4(count - base));
+		// Sphere_intersection rejects t >= tMax
+		valid = _mm_and_ps(valid, _mm_cmpnge_ps(t, _mm_set1_ps(*tMax)));
+		int mask = _mm_movemask_ps(valid);
+		if(mask == 0) continue;
+
+		// closest lane, the first one on ties like the scalar loop
+		__m128 masked = _mm_blendv_ps(_mm_set1_ps(INFINITY), t, valid);
+		__m128 closest = _mm_min_ps(masked, _mm_shuffle_ps(masked, masked, _MM_SHUFFLE(2, 3, 0, 1)));
+		closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+		int lane = SIMD_LOWEST_LANE(_mm_movemask_ps(_mm_cmpeq_ps(masked, closest)) & mask);
+		*tMax = _mm_cvtss_f32(closest);
+		best = first + base + lane;
+	}
+	return best;
+}
+
+SIMD_TARGET("sse4.1")
+static bool OccludedSSE41(const SpherePool *pool, int first, int count, Line *ray, float tMin, float tMax, const Model *ignore){
+	__m128 o[3] = {_mm_set1_ps(ray->origin.x), _mm_set1_ps(ray->origin.y), _mm_set1_ps(ray->origin.z)};
+	__m128 d[3] = {_mm_set1_ps(ray->direction.x), _mm_set1_ps(ray->direction.y), _mm_set1_ps(ray->direction.z)};
+	__m128 lower = _mm_set1_ps(tMin), upper = _mm_set1_ps(tMax);
+	for(int base = 0; base < count; base += 4){
+		__m128 valid = _mm_and_ps(Occluded4(pool, first + base, o, d, lower, upper), Lanes4(count - base));
+		int mask = _mm_movemask_ps(valid);
+		if(mask != 0 && AnyBlocker(pool, first + base, mask, ignore)) return true;
+	}
+	return false;
+}
+
+
+// ───── AVX2 kernel, 8 spheres ─────
+
+/**
+ * Closest hit test of 8 consecutive spheres starting at i. Comparisons are negated where Sphere_intersection
+ * rejects, so that NaNs are kept or rejected the same way.
+ *
+ * @return Mask of the lanes hit in front of the origin, their distances are written to distance.
+ */
+SIMD_TARGET("avx2")
+static inline __m256 Test8(const SpherePool *pool, int i, const __m256 o[3], const __m256 d[3], __m256 fourA, __m256 twoA, __m256 *distance){
+	__m256 lx = _mm256_sub_ps(o[0], _mm256_loadu_ps(pool->center[0] + i));
+	__m256 ly = _mm256_sub_ps(o[1], _mm256_loadu_ps(pool->center[1] + i));
+	__m256 lz = _mm256_sub_ps(o[2], _mm256_loadu_ps(pool->center[2] + i));
+
+	__m256 b = _mm256_mul_ps(_mm256_set1_ps(2), _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, d[0]), _mm256_mul_ps(ly, d[1])), _mm256_mul_ps(lz, d[2])));
+	__m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz)), _mm256_loadu_ps(pool->radiusSquared + i));
+	__m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(fourA, c));
+	__m256 valid = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_NLT_UQ);
+
+	__m256 sqrtDiscriminant = _mm256_sqrt_ps(discriminant);
+	__m256 minusB = _mm256_xor_ps(b, _mm256_set1_ps(-0.0f));
+	__m256 t1 = _mm256_div_ps(_mm256_sub_ps(minusB, sqrtDiscriminant), twoA);
+	__m256 t2 = _mm256_div_ps(_mm256_add_ps(minusB, sqrtDiscriminant), twoA);
+	__m256 front1 = _mm256_cmp_ps(t1, _mm256_setzero_ps(), _CMP_GT_OQ);
+	__m256 front2 = _mm256_cmp_ps(t2, _mm256_setzero_ps(), _CMP_GT_OQ);
+	*distance = _mm256_blendv_ps(t2, t1, front1);
+	return _mm256_and_ps(valid, _mm256_or_ps(front1, front2));
+}
+
+/**
+ * Occlusion test of 8 consecutive spheres starting at i, the direction of the ray is normalized like in Sphere_occluded.
+ *
+ * @return Mask of the lanes hit at a distance in (tMin, tMax).
+ */
+SIMD_TARGET("avx2")
+static inline __m256 Occluded8(const SpherePool *pool, int i, const __m256 o[3], const __m256 d[3], __m256 tMin, __m256 tMax){
+	__m256 lx = _mm256_sub_ps(o[0], _mm256_loadu_ps(pool->center[0] + i));
+	__m256 ly = _mm256_sub_ps(o[1], _mm256_loadu_ps(pool->center[1] + i));
+	__m256 lz = _mm256_sub_ps(o[2], _mm256_loadu_ps(pool->center[2] + i));
+
+	__m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, d[0]), _mm256_mul_ps(ly, d[1])), _mm256_mul_ps(lz, d[2]));
+	__m256 c = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lx, lx), _mm256_mul_ps(ly, ly)), _mm256_mul_ps(lz, lz)), _mm256_loadu_ps(pool->radiusSquared + i));
+	__m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(b, b), c);
+	__m256 valid = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_NLT_UQ);
+
+	__m256 sqrtDiscriminant = _mm256_sqrt_ps(discriminant);
+	__m256 minusB = _mm256_xor_ps(b, _mm256_set1_ps(-0.0f));
+	__m256 t1 = _mm256_sub_ps(minusB, sqrtDiscriminant);
+	__m256 t2 = _mm256_add_ps(minusB, sqrtDiscriminant);
+	__m256 in1 = _mm256_and_ps(_mm256_cmp_ps(t1, tMin, _CMP_GT_OQ), _mm256_cmp_ps(t1, tMax, _CMP_LT_OQ));
+	__m256 in2 = _mm256_and_ps(_mm256_cmp_ps(t2, tMin, _CMP_GT_OQ), _mm256_cmp_ps(t2, tMax, _CMP_LT_OQ));
+	return _mm256_and_ps(valid, _mm256_or_ps(in1, in2));
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 Lanes8(int count){
+	return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+
+SIMD_TARGET("avx2")
+static int IntersectAVX2(const SpherePool *pool, int first, int count, Line *ray, float *tMax){
+	// leaves of a few models would leave most of the lanes empty
+	if(count <= 4) return IntersectSSE41(pool, first, count, ray, tMax);
+	float a = Vector_dot(ray->direction, ray->direction);
+	__m256 fourA = _mm256_set1_ps(4 * a), twoA = _mm256_set1_ps(2 * a);
+	__m256 o[3] = {_mm256_set1_ps(ray->origin.x), _mm256_set1_ps(ray->origin.y), _mm256_set1_ps(ray->origin.z)};
+	__m256 d[3] = {_mm256_set1_ps(ray->direction.x), _mm256_set1_ps(ray->direction.y), _mm256_set1_ps(ray->direction.z)};
+	int best = -1;
+	for(int base = 0; base < count; base += 8){
+		__m256 t;
+		__m256 valid = _mm256_and_ps(Test8(pool, first + base, o, d, fourA, twoA, &t), Lanes8(count - base));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(*tMax), _CMP_NGE_UQ));
+		int mask = _mm256_movemask_ps(valid);
+		if(mask == 0) continue;
+
+		__m256 masked = _mm256_blendv_ps(_mm256_set1_ps(INFINITY), t, valid);
+		__m256 closest = _mm256_min_ps(masked, _mm256_permute2f128_ps(masked, masked, 1));
+		closest = _mm256_min_ps(closest, _mm256_shuffle_ps(closest, closest, _MM_SHUFFLE(2, 3, 0, 1)));
+		closest = _mm256_min_ps(closest, _mm256_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+		int lane = SIMD_LOWEST_LANE(_mm256_movemask_ps(_mm256_cmp_ps(masked, closest, _CMP_EQ_OQ)) & mask);
+		*tMax = _mm256_cvtss_f32(closest);
+		best = first + base + lane;
+	}
+	return best;
+}
+
+SIMD_TARGET("avx2")
+static bool OccludedAVX2(const SpherePool *pool, int first, int count, Line *ray, float tMin, float tMax, const Model *ignore){
+	if(count <= 4) return OccludedSSE41(pool, first, count, ray, tMin, tMax, ignore);
+	__m256 o[3] = {_mm256_set1_ps(ray->origin.x), _mm256_set1_ps(ray->origin.y), _mm256_set1_ps(ray->origin.z)};
+	__m256 d[3] = {_mm256_set1_ps(ray->direction.x), _mm256_set1_ps(ray->direction.y), _mm256_set1_ps(ray->direction.z)};
+	__m256 lower = _mm256_set1_ps(tMin), upper = _mm256_set1_ps(tMax);
+	for(int base = 0; base < count; base += 8){
+		__m256 valid = _mm256_and_ps(Occluded8(pool, first + base, o, d, lower, upper), Lanes8(count - base));
+		int mask = _mm256_movemask_ps(valid);
+		if(mask != 0 && AnyBlocker(pool, first + base, mask, ignore)) return true;
+	}
+	return false;
+}
+
+#endif
+
+
+// ───── Dispatch ─────
+
+typedef int (*IntersectKernel)(const SpherePool *pool, int first, int count, Line *ray, float *tMax);
+typedef bool (*OccludedKernel)(const SpherePool *pool, int first, int count, Line *ray, float tMin, float tMax, const Model *ignore);
+
+static const IntersectKernel intersectKernels[SIMD_NUM_LEVELS] = {
+#if SIMD_X86
+	IntersectScalar, IntersectSSE41, IntersectAVX2
+#else
+	IntersectScalar, IntersectScalar, IntersectScalar
+#endif
+};
+
+static const OccludedKernel occludedKernels[SIMD_NUM_LEVELS] = {
+#if SIMD_X86
+	OccludedScalar, OccludedSSE41, OccludedAVX2
+#else
+	OccludedScalar, OccludedScalar, OccludedScalar
+#endif
+};
+
+int SpherePool_intersect(const SpherePool *pool, int first, int count, Line *ray, float *tMax){
+	return intersectKernels[simdLevel](pool, first, count, ray, tMax);
+}
+
+bool SpherePool_occluded(const SpherePool *pool, int first, int count, Line *ray, float tMin, float tMax, const Model *ignore){
+	return occludedKernels[simdLevel](pool, first, count, ray, tMin, tMax, ignore);
+}
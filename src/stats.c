@@ -0,0 +1,133 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include"stats.h"
+
+#ifdef RAYTRACING_STATS
+_Thread_local RenderStats threadStats;
+_Thread_local ModelCosts threadModelCosts;
+#endif
+
+static const char *counterNames[STAT_NUM_COUNTERS] = {"triangle tests", "sphere tests", "bounds rejects", "shadow early-outs"};
+static const char *timerNames[STAT_NUM_TIMERS] = {"trace", "shadow", "present"};
+
+void Stats_flush(RenderStats *target){
+#ifdef RAYTRACING_STATS
+	Stats_merge(target, &threadStats);
+	Stats_reset(&threadStats);
+#else
+	(void)target;
+#endif
+}
+
+int Stats_flushModelCosts(ModelCosts *target){
+#ifdef RAYTRACING_STATS
+	for(int i = 0; i < threadModelCosts.count; i++){
+		ModelCost *cost = &threadModelCosts.costs[i];
+		if(cost->queries == 0) continue;
+		if(Stats_addModelCost(target, i, cost->queries, cost->time) != 0) return -1;
+	}
+	Stats_resetModelCosts(&threadModelCosts);
+#else
+	(void)target;
+#endif
+	return 0;
+}
+
+int Stats_addModelCost(ModelCosts *costs, int index, uint64_t queries, double time){
+	if(index >= costs->count){
+		int count = index + 1 > 2 * costs->count ? index + 1 : 2 * costs->count;
+		ModelCost *grown = realloc(costs->costs, count * sizeof(ModelCost));
+		if(grown == NULL){
+			printf("ERROR::STATS::Stats_addModelCost::Failed to allocate memory for model costs\n");
+			return -1;
+		}
+		memset(grown + costs->count, 0, (count - costs->count) * sizeof(ModelCost));
+		costs->costs = grown;
+		costs->count = count;
+	}
+	costs->costs[index].queries += queries;
+	costs->costs[index].time += time;
+	return 0;
+}
+
+int Stats_addSphereCosts(RenderStats *stats, ModelCosts *costs, const SpherePool *pool, const int *models, int first, int count, double time){
+	int spheres = 0;
+	for(int i = 0; i < count; i++) spheres += SpherePool_isSphere(pool, first + i);
+	if(spheres == 0) return 0;
+	stats->counters[STAT_SPHERE_TESTS] += spheres;
+	for(int i = 0; i < count; i++){
+		if(!SpherePool_isSphere(pool, first + i)) continue;
+		if(Stats_addModelCost(costs, models[i], 1, time / spheres) != 0) return -1;
+	}
+	return 0;
+}
+
+void Stats_resetModelCosts(ModelCosts *costs){
+	if(costs->count > 0) memset(costs->costs, 0, costs->count * sizeof(ModelCost));
+}
+
+void Stats_freeModelCosts(ModelCosts *costs){
+	free(costs->costs);
+	costs->costs = NULL;
+	costs->count = 0;
+}
+
+void Stats_merge(RenderStats *target, const RenderStats *source){
+	for(int i = 0; i < STAT_NUM_COUNTERS; i++) target->counters[i] += source->counters[i];
+	for(int i = 0; i < STAT_NUM_TIMERS; i++) target->timers[i] += source->timers[i];
+}
+
+void Stats_reset(RenderStats *stats){
+	memset(stats, 0, sizeof(RenderStats));
+}
+
+const char *Stats_counterName(StatCounter counter){
+	return counter < STAT_NUM_COUNTERS ? counterNames[counter] : "unknown";
+}
+
+const char *Stats_timerName(StatTimer timer){
+	return timer < STAT_NUM_TIMERS ? timerNames[timer] : "unknown";
+}
+
+void Stats_print(const RenderStats *stats){
+	if(!STATS_ENABLED) return;
+	for(int i = 0; i < STAT_NUM_COUNTERS; i++){
+		printf("%s%s: %llu", i > 0 ? ", " : "", counterNames[i], (unsigned long long)stats->counters[i]);
+	}
+	printf("\n");
+	for(int i = 0; i < STAT_NUM_TIMERS; i++){
+		printf("%s%s: %.1f ms", i > 0 ? ", " : "", timerNames[i], stats->timers[i]);
+	}
+	printf("\n");
+}
+
+void Stats_printModelCosts(const ModelCosts *costs, const Scene *scene, int maxModels){
+	if(!STATS_ENABLED) return;
+	double total = 0;
+	for(int i = 0; i < costs->count; i++) total += costs->costs[i].time;
+	if(total <= 0) return;
+
+	// selection of the most expensive models, the scene rarely has more than a few hundred of them
+	bool *printed = calloc(costs->count, sizeof(bool));
+	if(printed == NULL){
+		printf("ERROR::STATS::Stats_printModelCosts::Failed to allocate memory\n");
+		return;
+	}
+	static const char *typeNames[] = {"mesh", "sphere", "light"};
+	printf("%-6s %-7s %10s %12s %10s %6s\n", "model", "type", "triangles", "queries", "time", "share");
+	for(int n = 0; n < maxModels && n < costs->count; n++){
+		int best = -1;
+		for(int i = 0; i < costs->count; i++){
+			if(!printed[i] && (best < 0 || costs->costs[i].time > costs->costs[best].time)) best = i;
+		}
+		if(best < 0 || costs->costs[best].queries == 0) break;
+		printed[best] = true;
+
+		const ModelCost *cost = &costs->costs[best];
+		Model *model = best < (int)scene->numModels ? scene->models[best] : NULL;
+		printf("%-6d %-7s %10d %12llu %7.1f ms %5.1f%%\n", best, model != NULL ? typeNames[model->type] : "?",
+			model != NULL ? model->numTriangles : 0, (unsigned long long)cost->queries, cost->time, 100 * cost->time / total);
+	}
+	free(printed);
+}
@@ -0,0 +1,225 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include"threadpool.h"
+#include"trace.h"
+
+#ifdef _WIN32
+#include<windows.h>
+#else
+#include<unistd.h>
+#endif
+
+int ThreadPool_numCores(){
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	int numCores = (int)info.dwNumberOfProcessors;
+#else
+	int numCores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return numCores > 0 ? numCores : 1;
+}
+
+
+// ───── DEQUE ─────
+
+static bool TaskDeque_reserve(TaskDeque *deque, int capacity){
+	if(capacity <= deque->capacity) return true;
+	int *tasks = realloc(deque->tasks, capacity * sizeof(int));
+	if(tasks == NULL){
+		printf("ERROR::THREADPOOL::TaskDeque_reserve::Failed to allocate memory for task deque\n");
+		return false;
+	}
+	deque->tasks = tasks;
+	deque->capacity = capacity;
+	return true;
+}
+
+/**
+ * Fills the deque with the range [first, last), only called while the workers are idle.
+ * The range is stored reversed so that the owner pops it in ascending order.
+ */
+static void TaskDeque_fill(TaskDeque *deque, int first, int last){
+	int count = last - first;
+	for(int i = 0; i < count; i++){
+		deque->tasks[i] = last - 1 - i;
+	}
+	atomic_store(&deque->top, 0);
+	atomic_store(&deque->bottom, count);
+}
+
+static bool TaskDeque_pop(TaskDeque *deque, int *task){
+	int b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	int t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+	if(t > b){
+		atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+		return false;
+	}
+	*task = deque->tasks[b];
+	if(t == b){
+		// last task, race against thieves for it
+		bool won = atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+		atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+		return won;
+	}
+	return true;
+}
+
+/**
+ * Tries to steal the task at the top of the deque.
+ * Returns 1 on success, 0 if the deque is empty and -1 if another thread won the race.
+ */
+static int TaskDeque_steal(TaskDeque *deque, int *task){
+	int t = atomic_load_explicit(&deque->top, memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	int b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+	if(t >= b) return 0;
+
+	*task = deque->tasks[t];
+	if(!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)){
+		return -1;
+	}
+	return 1;
+}
+
+
+// ───── POOL ─────
+
+static bool StealTask(ThreadPool *pool, int thief, int *task){
+	while(1){
+		bool contended = false;
+		for(int i = 1; i < pool->numWorkers; i++){
+			Worker *victim = &pool->workers[(thief + i) % pool->numWorkers];
+			int result = TaskDeque_steal(&victim->deque, task);
+			if(result == 1){
+				Trace_instant("steal", thief, "victim", victim->index);
+				return true;
+			}
+			if(result == -1) contended = true;
+		}
+		// every deque was seen empty, the job has no work left to take
+		if(!contended) return false;
+	}
+}
+
+static void *WorkerMain(void *args){
+	Worker *worker = (Worker*)args;
+	ThreadPool *pool = worker->pool;
+	unsigned int lastJob = 0;
+
+	while(1){
+		pthread_mutex_lock(&pool->mutex);
+		while(pool->jobId == lastJob && !pool->shutdown){
+			pthread_cond_wait(&pool->jobReady, &pool->mutex);
+		}
+		if(pool->shutdown){
+			pthread_mutex_unlock(&pool->mutex);
+			return NULL;
+		}
+		lastJob = pool->jobId;
+		ThreadPoolTask taskFunction = pool->task;
+		void *context = pool->context;
+		pthread_mutex_unlock(&pool->mutex);
+
+		int task;
+		while(TaskDeque_pop(&worker->deque, &task) || StealTask(pool, worker->index, &task)){
+			taskFunction(context, task, worker->index);
+		}
+
+		pthread_mutex_lock(&pool->mutex);
+		pool->activeWorkers--;
+		if(pool->activeWorkers == 0) pthread_cond_signal(&pool->jobDone);
+		pthread_mutex_unlock(&pool->mutex);
+	}
+}
+
+ThreadPool *ThreadPool_new(int numWorkers){
+	if(numWorkers < 1) numWorkers = ThreadPool_numCores();
+
+	ThreadPool *pool = malloc(sizeof(ThreadPool));
+	if(pool == NULL){
+		printf("ERROR::THREADPOOL::ThreadPool_new::Failed to allocate memory for ThreadPool\n");
+		return NULL;
+	}
+	pool->workers = calloc(numWorkers, sizeof(Worker));
+	if(pool->workers == NULL){
+		printf("ERROR::THREADPOOL::ThreadPool_new::Failed to allocate memory for workers\n");
+		free(pool);
+		return NULL;
+	}
+	pool->numWorkers = numWorkers;
+	pool->jobId = 0;
+	pool->activeWorkers = 0;
+	pool->shutdown = false;
+	pool->task = NULL;
+	pool->context = NULL;
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->jobReady, NULL);
+	pthread_cond_init(&pool->jobDone, NULL);
+
+	for(int i = 0; i < numWorkers; i++){
+		Worker *worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+		worker->deque.tasks = NULL;
+		worker->deque.capacity = 0;
+		atomic_init(&worker->deque.top, 0);
+		atomic_init(&worker->deque.bottom, 0);
+		if(pthread_create(&worker->thread, NULL, WorkerMain, worker) != 0){
+			printf("ERROR::THREADPOOL::ThreadPool_new::Failed to start worker %d\n", i);
+			// a job would wait forever for the missing worker, stop the ones already started instead
+			pool->numWorkers = i;
+			ThreadPool_free(pool);
+			return NULL;
+		}
+	}
+	return pool;
+}
+
+int ThreadPool_run(ThreadPool *pool, int numTasks, ThreadPoolTask task, void *context){
+	if(pool == NULL) return -1;
+	if(numTasks <= 0) return 0;
+
+	// workers are idle here, so the deques can be refilled without synchronization
+	int numWorkers = pool->numWorkers;
+	for(int i = 0; i < numWorkers; i++){
+		int first = (int)((long long)i * numTasks / numWorkers);
+		int last = (int)((long long)(i + 1) * numTasks / numWorkers);
+		TaskDeque *deque = &pool->workers[i].deque;
+		if(!TaskDeque_reserve(deque, last - first)) return -1;
+		TaskDeque_fill(deque, first, last);
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->context = context;
+	pool->activeWorkers = numWorkers;
+	pool->jobId++;
+	pthread_cond_broadcast(&pool->jobReady);
+	while(pool->activeWorkers > 0){
+		pthread_cond_wait(&pool->jobDone, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return 0;
+}
+
+void ThreadPool_free(ThreadPool *pool){
+	if(pool == NULL) return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = true;
+	pthread_cond_broadcast(&pool->jobReady);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for(int i = 0; i < pool->numWorkers; i++){
+		pthread_join(pool->workers[i].thread, NULL);
+		free(pool->workers[i].deque.tasks);
+	}
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->jobReady);
+	pthread_cond_destroy(&pool->jobDone);
+	free(pool->workers);
+	free(pool);
+}
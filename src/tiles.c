@@ -0,0 +1,78 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include"tiles.h"
+
+// spreads the lower 16 bits of v so that there is a zero bit between each of them
+static uint32_t SpreadBits(uint32_t v){
+	v &= 0x0000FFFF;
+	v = (v | (v << 8)) & 0x00FF00FF;
+	v = (v | (v << 4)) & 0x0F0F0F0F;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+static uint32_t CompactBits(uint32_t v){
+	v &= 0x55555555;
+	v = (v | (v >> 1)) & 0x33333333;
+	v = (v | (v >> 2)) & 0x0F0F0F0F;
+	v = (v | (v >> 4)) & 0x00FF00FF;
+	v = (v | (v >> 8)) & 0x0000FFFF;
+	return v;
+}
+
+uint32_t Morton_encode(uint32_t x, uint32_t y){
+	return SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+void Morton_decode(uint32_t code, uint32_t *x, uint32_t *y){
+	*x = CompactBits(code);
+	*y = CompactBits(code >> 1);
+}
+
+int TileGrid_init(TileGrid *grid, int width, int height, int tileSize){
+	int size = 1;
+	while(size < tileSize) size <<= 1;
+
+	grid->width = width;
+	grid->height = height;
+	grid->tileSize = size;
+	grid->tilesX = (width + size - 1) / size;
+	grid->tilesY = (height + size - 1) / size;
+	grid->numTiles = grid->tilesX * grid->tilesY;
+	grid->order = malloc(grid->numTiles * sizeof(int));
+	if(grid->order == NULL){
+		printf("ERROR::TILES::TileGrid_init::Failed to allocate memory for tile order\n");
+		grid->numTiles = 0;
+		return -1;
+	}
+
+	// walk the Morton curve of the enclosing power-of-two square, skipping codes outside the grid
+	int side = 1;
+	while(side < grid->tilesX || side < grid->tilesY) side <<= 1;
+	int count = 0;
+	for(uint32_t code = 0; code < (uint32_t)side * side && count < grid->numTiles; code++){
+		uint32_t x, y;
+		Morton_decode(code, &x, &y);
+		if((int)x >= grid->tilesX || (int)y >= grid->tilesY) continue;
+		grid->order[count++] = y * grid->tilesX + x;
+	}
+	return 0;
+}
+
+Tile TileGrid_getTile(const TileGrid *grid, int i){
+	int index = grid->order[i];
+	Tile tile;
+	tile.x = (index % grid->tilesX) * grid->tileSize;
+	tile.y = (index / grid->tilesX) * grid->tileSize;
+	tile.width = tile.x + grid->tileSize <= grid->width ? grid->tileSize : grid->width - tile.x;
+	tile.height = tile.y + grid->tileSize <= grid->height ? grid->tileSize : grid->height - tile.y;
+	return tile;
+}
+
+void TileGrid_free(TileGrid *grid){
+	if(grid == NULL) return;
+	free(grid->order);
+	grid->order = NULL;
+	grid->numTiles = 0;
+}
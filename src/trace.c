@@ -0,0 +1,98 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include"trace.h"
+#include"utils.h"
+
+atomic_bool traceEnabled = false;
+
+static TraceEvent *events = NULL;
+static int capacity = 0;
+static atomic_int numEvents = 0;
+static double origin = 0;
+
+int Trace_begin(int maxEvents){
+	atomic_store(&traceEnabled, false);
+	if(maxEvents <= 0) maxEvents = TRACE_DEFAULT_CAPACITY;
+	if(maxEvents > capacity){
+		TraceEvent *buffer = realloc(events, maxEvents * sizeof(TraceEvent));
+		if(buffer == NULL){
+			printf("ERROR::TRACE::Trace_begin::Failed to allocate memory for events\n");
+			return -1;
+		}
+		events = buffer;
+		capacity = maxEvents;
+	}
+	atomic_store(&numEvents, 0);
+	origin = GetTimeMs();
+	atomic_store(&traceEnabled, true);
+	return 0;
+}
+
+static void Record(TraceEvent event){
+	int index = atomic_fetch_add_explicit(&numEvents, 1, memory_order_relaxed);
+	if(index >= capacity) return;
+	events[index] = event;
+}
+
+void Trace_complete(const char *name, int thread, double start, double end, const char *argName, int arg){
+	if(!Trace_enabled()) return;
+	Record((TraceEvent){name, 'X', thread, start, end - start, argName, arg});
+}
+
+void Trace_instant(const char *name, int thread, const char *argName, int arg){
+	if(!Trace_enabled()) return;
+	Record((TraceEvent){name, 'i', thread, GetTimeMs(), 0, argName, arg});
+}
+
+void Trace_nameThread(int thread, const char *name){
+	if(!Trace_enabled()) return;
+	Record((TraceEvent){name, 'M', thread, 0, 0, NULL, 0});
+}
+
+static void WriteEvent(FILE *file, const TraceEvent *event){
+	if(event->phase == 'M'){
+		fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", event->thread, event->name);
+		return;
+	}
+	// timestamps and durations are in microseconds
+	fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f", event->name, event->phase, event->thread, (event->start - origin) * 1000);
+	if(event->phase == 'X') fprintf(file, ",\"dur\":%.3f", event->duration * 1000);
+	else fprintf(file, ",\"s\":\"t\"");
+	if(event->argName != NULL) fprintf(file, ",\"args\":{\"%s\":%d}", event->argName, event->arg);
+	fprintf(file, "}");
+}
+
+int Trace_end(const char *path){
+	if(!Trace_enabled()) return -1;
+	atomic_store(&traceEnabled, false);
+
+	FILE *file = fopen(path, "w");
+	if(file == NULL){
+		printf("ERROR::TRACE::Trace_end::Failed to open %s\n", path);
+		return -1;
+	}
+	int count = atomic_load(&numEvents);
+	if(count > capacity){
+		printf("Trace: %d events dropped, the buffer holds %d\n", count - capacity, capacity);
+		count = capacity;
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	// the workers of the pool are named after their index, unless named explicitly
+	bool named[TRACE_THREAD_RENDER] = {false};
+	for(int i = 0; i < count; i++){
+		if(events[i].phase == 'M' && events[i].thread >= 0 && events[i].thread < TRACE_THREAD_RENDER) named[events[i].thread] = true;
+	}
+	for(int i = 0; i < count; i++){
+		int thread = events[i].thread;
+		if(thread >= 0 && thread < TRACE_THREAD_RENDER && !named[thread]){
+			fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}},\n", thread, thread);
+			named[thread] = true;
+		}
+		WriteEvent(file, &events[i]);
+		fprintf(file, i < count - 1 ? ",\n" : "\n");
+	}
+	fprintf(file, "],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(file);
+	return 0;
+}
@@ -1,51 +1,69 @@
 #include"triangle.h"
 #include<stdio.h>
 #include<stdlib.h>
+#include<math.h>
 
-Triangle *Triangle_init(Point *a, Point *b, Point *c, unsigned char material){
-	Triangle *t = malloc(sizeof(Triangle));
-	if(t == NULL){
-		printf("ERROR::TRIANGLE::Triangle_init::Failed to allocate memory for Triangle\n");
-		return NULL;
-	}
-	t->a = Point_copy(a);
-	t->b = Point_copy(b);
-	t->c = Point_copy(c);
-	t->material = material;
+Triangle Triangle_new(Point a, Point b, Point c, unsigned short material){
+	Triangle t;
+	t.a = a;
+	t.b = b;
+	t.c = c;
+	t.material = material;
 	return t;
 }
 
-Vector Triangle_getNormal(Triangle *t){
+Vector Triangle_getNormal(const Triangle *t){
       if(t == NULL){
             printf("ERROR::TRIANGLE::Triangle_getNormal::Triangle is NULL\n");
             return Vector_init(0, 0, 0);
       }
 	Vector ab, ac;
-	ab = Vector_fromPoints(t->a, t->b);
-	ac = Vector_fromPoints(t->a, t->c);
+	ab = Vector_fromPoints(&t->a, &t->b);
+	ac = Vector_fromPoints(&t->a, &t->c);
 	Vector normal = Vector_crossProduct(ab, ac);
 	return Vector_normalize(normal);
 }
 
-void Triangle_translate(Triangle *t, Vector translation){
-	t->a = Point_translate(t->a, translation);
-	t->b = Point_translate(t->b, translation);
-	t->c = Point_translate(t->c, translation);
+bool Triangle_intersect(const Triangle *t, Line *ray, float *distance){
+	float EPSILON = 1e-5;
+	Vector e1 = Vector_fromPoints(&t->a, &t->b);
+	Vector e2 = Vector_fromPoints(&t->a, &t->c);
+
+	Vector h = Vector_crossProduct(ray->direction, e2);
+	float a = Vector_dot(e1, h);
+	if (fabs(a) < EPSILON) {
+		return false;
+	}
+
+	Vector s = Vector_fromPoints(&t->a, &ray->origin);
+	float u = Vector_dot(s, h) / a;
+	if (u < 0.0 || u > 1.0) {
+		return false;
+	}
+
+	Vector q = Vector_crossProduct(s, e1);
+	float v = Vector_dot(ray->direction, q) / a;
+	if (v < 0.0 || u + v > 1.0) {
+		return false;
+	}
+
+	float ti = Vector_dot(e2, q) / a;
+	//if intersection is in the opposite direction of the line exclude it
+	if (ti < 1e-6) return false;
+
+	*distance = ti;
+	return true;
 }
 
-Point *Triangle_center(Triangle *t){
-	Point *center = Point_init(0, 0, 0);
-	center->x = (t->a->x + t->b->x + t->c->x) / 3;
-	center->y = (t->a->y + t->b->y + t->c->y) / 3;
-	center->z = (t->a->z + t->b->z + t->c->z) / 3;
+Point Triangle_center(const Triangle *t){
+	Point center;
+	center.x = (t->a.x + t->b.x + t->c.x) / 3;
+	center.y = (t->a.y + t->b.y + t->c.y) / 3;
+	center.z = (t->a.z + t->b.z + t->c.z) / 3;
 
 	return center;
 }
 
-size_t Triangle_size(Triangle *t){
-	size_t size = sizeof(*t);
-	size += Point_size(t->a);
-	size += Point_size(t->b);
-	size += Point_size(t->c);
-	return size;
+size_t Triangle_size(const Triangle *t){
+	return sizeof(*t);
 }
\ No newline at end of file
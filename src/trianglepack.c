@@ -0,0 +1,303 @@
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<math.h>
+#include"trianglepack.h"
+#include"simd.h"
+
+// same thresholds as Triangle_intersect, t <= 1e-6f is exactly the float test of t < 1e-6
+#define PACK_EPSILON 1e-5f
+#define PACK_MIN_DISTANCE 1e-6f
+
+TrianglePack *TrianglePack_new(int count){
+	if(count <= 0) return NULL;
+	TrianglePack *pack = malloc(sizeof(TrianglePack));
+	// padding lanes are zeroed, their determinant is 0 and they never hit
+	int stride = count + TRIANGLE_PACK_WIDTH;
+	float *data = calloc(9 * (size_t)stride, sizeof(float));
+	if(pack == NULL || data == NULL){
+		printf("ERROR::TRIANGLEPACK::TrianglePack_new::Failed to allocate memory for the pack\n");
+		free(pack);
+		free(data);
+		return NULL;
+	}
+	for(int axis = 0; axis < 3; axis++){
+		pack->v0[axis] = data + axis * stride;
+		pack->e1[axis] = data + (3 + axis) * stride;
+		pack->e2[axis] = data + (6 + axis) * stride;
+	}
+	pack->count = count;
+	Simd_init();
+	return pack;
+}
+
+void TrianglePack_set(TrianglePack *pack, int i, const Triangle *t){
+	Vector e1 = Vector_fromPoints(&t->a, &t->b);
+	Vector e2 = Vector_fromPoints(&t->a, &t->c);
+	pack->v0[0][i] = t->a.x;
+	pack->v0[1][i] = t->a.y;
+	pack->v0[2][i] = t->a.z;
+	pack->e1[0][i] = e1.x;
+	pack->e1[1][i] = e1.y;
+	pack->e1[2][i] = e1.z;
+	pack->e2[0][i] = e2.x;
+	pack->e2[1][i] = e2.y;
+	pack->e2[2][i] = e2.z;
+}
+
+size_t TrianglePack_size(const TrianglePack *pack){
+	if(pack == NULL) return 0;
+	return sizeof(*pack) + 9 * (size_t)(pack->count + TRIANGLE_PACK_WIDTH) * sizeof(float);
+}
+
+void TrianglePack_free(TrianglePack *pack){
+	if(pack == NULL) return;
+	free(pack->v0[0]);
+	free(pack);
+}
+
+
+// ───── Scalar kernel ─────
+
+/**
+ * Möller–Trumbore test of the i-th triangle, written like Triangle_intersect.
+ */
+static bool IntersectOne(const TrianglePack *pack, int i, const Line *ray, float *distance){
+	Vector e1 = {pack->e1[0][i], pack->e1[1][i], pack->e1[2][i], 0};
+	Vector e2 = {pack->e2[0][i], pack->e2[1][i], pack->e2[2][i], 0};
+	Vector d = ray->direction;
+
+	Vector h = {d.y * e2.z - d.z * e2.y, d.z * e2.x - d.x * e2.z, d.x * e2.y - d.y * e2.x, 0};
+	float a = e1.x*h.x + e1.y*h.y + e1.z*h.z;
+	if(fabsf(a) < PACK_EPSILON) return false;
+
+	Vector s = {ray->origin.x - pack->v0[0][i], ray->origin.y - pack->v0[1][i], ray->origin.z - pack->v0[2][i], 0};
+	float u = (s.x*h.x + s.y*h.y + s.z*h.z) / a;
+	if(u < 0 || u > 1) return false;
+
+	Vector q = {s.y * e1.z - s.z * e1.y, s.z * e1.x - s.x * e1.z, s.x * e1.y - s.y * e1.x, 0};
+	float v = (d.x*q.x + d.y*q.y + d.z*q.z) / a;
+	if(v < 0 || u + v > 1) return false;
+
+	float t = (e2.x*q.x + e2.y*q.y + e2.z*q.z) / a;
+	if(t <= PACK_MIN_DISTANCE) return false;
+	*distance = t;
+	return true;
+}
+
+static int IntersectScalar(const TrianglePack *pack, int first, int count, Line *ray, float *tMax){
+	int best = -1;
+	for(int i = first; i < first + count; i++){
+		float t;
+		if(IntersectOne(pack, i, ray, &t) && t < *tMax){
+			*tMax = t;
+			best = i;
+		}
+	}
+	return best;
+}
+
+static bool OccludedScalar(const TrianglePack *pack, int first, int count, Line *ray, float tMin, float tMax){
+	for(int i = first; i < first + count; i++){
+		float t;
+		if(IntersectOne(pack, i, ray, &t) && t > tMin && t < tMax) return true;
+	}
+	return false;
+}
+
+
+#if SIMD_X86
+
+// ───── SSE4.1 kernel, 4 triangles ─────
+
+/**
+ * Möller–Trumbore test of 4 consecutive triangles starting at i. Comparisons are negated where
+ * Triangle_intersect rejects, so that NaNs are kept or rejected the same way.
+ *
+ * @return Mask of the lanes hit in front of the origin, their distances are written to distance.
+ */
+SIMD_TARGET("sse4.1")
+static inline __m128 Test4(const TrianglePack *pack, int i, const __m128 o[3], const __m128 d[3], __m128 *distance){
+	__m128 e1x = _mm_loadu_ps(pack->e1[0] + i), e1y = _mm_loadu_ps(pack->e1[1] + i), e1z = _mm_loadu_ps(pack->e1[2] + i);
+	__m128 e2x = _mm_loadu_ps(pack->e2[0] + i), e2y = _mm_loadu_ps(pack->e2[1] + i), e2z = _mm_loadu_ps(pack->e2[2] + i);
+
+	__m128 hx = _mm_sub_ps(_mm_mul_ps(d[1], e2z), _mm_mul_ps(d[2], e2y));
+	__m128 hy = _mm_sub_ps(_mm_mul_ps(d[2], e2x), _mm_mul_ps(d[0], e2z));
+	__m128 hz = _mm_sub_ps(_mm_mul_ps(d[0], e2y), _mm_mul_ps(d[1], e2x));
+	__m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, hx), _mm_mul_ps(e1y, hy)), _mm_mul_ps(e1z, hz));
+	__m128 absA = _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+	__m128 valid = _mm_cmpnlt_ps(absA, _mm_set1_ps(PACK_EPSILON));
+
+	__m128 sx = _mm_sub_ps(o[0], _mm_loadu_ps(pack->v0[0] + i));
+	__m128 sy = _mm_sub_ps(o[1], _mm_loadu_ps(pack->v0[1] + i));
+	__m128 sz = _mm_sub_ps(o[2], _mm_loadu_ps(pack->v0[2] + i));
+	__m128 u = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, hx), _mm_mul_ps(sy, hy)), _mm_mul_ps(sz, hz)), a);
+	valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpnlt_ps(u, _mm_setzero_ps()), _mm_cmpngt_ps(u, _mm_set1_ps(1))));
+
+	__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+	__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+	__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+	__m128 v = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qx), _mm_mul_ps(d[1], qy)), _mm_mul_ps(d[2], qz)), a);
+	valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpnlt_ps(v, _mm_setzero_ps()), _mm_cmpngt_ps(_mm_add_ps(u, v), _mm_set1_ps(1))));
+
+	__m128 t = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), a);
+	valid = _mm_and_ps(valid, _mm_cmpnle_ps(t, _mm_set1_ps(PACK_MIN_DISTANCE)));
+	*distance = t;
+	return valid;
+}
+
+/**
+ * Mask of the first count lanes of a group of 4.
+ */
+SIMD_TARGET("sse4.1")
+static inline __m128 Lanes4(int count){
+	return _mm_castsi128_ps(_mm_cmplt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(count)));
+}
+
+SIMD_TARGET("sse4.1")
+static int IntersectSSE41(const TrianglePack *pack, int first, int count, Line *ray, float *tMax){
+	__m128 o[3] = {_mm_set1_ps(ray->origin.x), _mm_set1_ps(ray->origin.y), _mm_set1_ps(ray->origin.z)};
+	__m128 d[3] = {_mm_set1_ps(ray->direction.x), _mm_set1_ps(ray->direction.y), _mm_set1_ps(ray->direction.z)};
+	int best = -1;
+	for(int base = 0; base < count; base += 4){
+		__m128 t;
+		__m128 valid = _mm_and_ps(Test4(pack, first + base, o, d, &t), Lanes4(count - base));
+		valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(*tMax)));
+		int mask = _mm_movemask_ps(valid);
+		if(mask == 0) continue;
+
+		// closest lane, the first one on ties like the scalar loop
+		__m128 masked = _mm_blendv_ps(_mm_set1_ps(INFINITY), t, valid);
+		__m128 closest = _mm_min_ps(masked, _mm_shuffle_ps(masked, masked, _MM_SHUFFLE(2, 3, 0, 1)));
+		closest = _mm_min_ps(closest, _mm_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+		int lane = SIMD_LOWEST_LANE(_mm_movemask_ps(_mm_cmpeq_ps(masked, closest)) & mask);
+		*tMax = _mm_cvtss_f32(closest);
+		best = first + base + lane;
+	}
+	return best;
+}
+
+SIMD_TARGET("sse4.1")
+static bool OccludedSSE41(const TrianglePack *pack, int first, int count, Line *ray, float tMin, float tMax){
+	__m128 o[3] = {_mm_set1_ps(ray->origin.x), _mm_set1_ps(ray->origin.y), _mm_set1_ps(ray->origin.z)};
+	__m128 d[3] = {_mm_set1_ps(ray->direction.x), _mm_set1_ps(ray->direction.y), _mm_set1_ps(ray->direction.z)};
+	for(int base = 0; base < count; base += 4){
+		__m128 t;
+		__m128 valid = _mm_and_ps(Test4(pack, first + base, o, d, &t), Lanes4(count - base));
+		valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, _mm_set1_ps(tMin)), _mm_cmplt_ps(t, _mm_set1_ps(tMax))));
+		if(_mm_movemask_ps(valid) != 0) return true;
+	}
+	return false;
+}
+
+
+// ───── AVX2 kernel, 8 triangles ─────
+
+/**
+ * Möller–Trumbore test of 8 consecutive triangles starting at i, see Test4.
+ */
+SIMD_TARGET("avx2")
+static inline __m256 Test8(const TrianglePack *pack, int i, const __m256 o[3], const __m256 d[3], __m256 *distance){
+	__m256 e1x = _mm256_loadu_ps(pack->e1[0] + i), e1y = _mm256_loadu_ps(pack->e1[1] + i), e1z = _mm256_loadu_ps(pack->e1[2] + i);
+	__m256 e2x = _mm256_loadu_ps(pack->e2[0] + i), e2y = _mm256_loadu_ps(pack->e2[1] + i), e2z = _mm256_loadu_ps(pack->e2[2] + i);
+
+	__m256 hx = _mm256_sub_ps(_mm256_mul_ps(d[1], e2z), _mm256_mul_ps(d[2], e2y));
+	__m256 hy = _mm256_sub_ps(_mm256_mul_ps(d[2], e2x), _mm256_mul_ps(d[0], e2z));
+	__m256 hz = _mm256_sub_ps(_mm256_mul_ps(d[0], e2y), _mm256_mul_ps(d[1], e2x));
+	__m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, hx), _mm256_mul_ps(e1y, hy)), _mm256_mul_ps(e1z, hz));
+	__m256 absA = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+	__m256 valid = _mm256_cmp_ps(absA, _mm256_set1_ps(PACK_EPSILON), _CMP_NLT_UQ);
+
+	__m256 sx = _mm256_sub_ps(o[0], _mm256_loadu_ps(pack->v0[0] + i));
+	__m256 sy = _mm256_sub_ps(o[1], _mm256_loadu_ps(pack->v0[1] + i));
+	__m256 sz = _mm256_sub_ps(o[2], _mm256_loadu_ps(pack->v0[2] + i));
+	__m256 u = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, hx), _mm256_mul_ps(sy, hy)), _mm256_mul_ps(sz, hz)), a);
+	valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_NLT_UQ), _mm256_cmp_ps(u, _mm256_set1_ps(1), _CMP_NGT_UQ)));
+
+	__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+	__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+	__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+	__m256 v = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(d[0], qx), _mm256_mul_ps(d[1], qy)), _mm256_mul_ps(d[2], qz)), a);
+	valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NLT_UQ), _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1), _CMP_NGT_UQ)));
+
+	__m256 t = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)), a);
+	valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(PACK_MIN_DISTANCE), _CMP_NLE_UQ));
+	*distance = t;
+	return valid;
+}
+
+SIMD_TARGET("avx2")
+static inline __m256 Lanes8(int count){
+	return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+
+SIMD_TARGET("avx2")
+static int IntersectAVX2(const TrianglePack *pack, int first, int count, Line *ray, float *tMax){
+	// small leaves, e.g. the two triangles of a rectangle, would leave most of the lanes empty
+	if(count <= 4) return IntersectSSE41(pack, first, count, ray, tMax);
+	__m256 o[3] = {_mm256_set1_ps(ray->origin.x), _mm256_set1_ps(ray->origin.y), _mm256_set1_ps(ray->origin.z)};
+	__m256 d[3] = {_mm256_set1_ps(ray->direction.x), _mm256_set1_ps(ray->direction.y), _mm256_set1_ps(ray->direction.z)};
+	int best = -1;
+	for(int base = 0; base < count; base += 8){
+		__m256 t;
+		__m256 valid = _mm256_and_ps(Test8(pack, first + base, o, d, &t), Lanes8(count - base));
+		valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, _mm256_set1_ps(*tMax), _CMP_LT_OQ));
+		int mask = _mm256_movemask_ps(valid);
+		if(mask == 0) continue;
+
+		__m256 masked = _mm256_blendv_ps(_mm256_set1_ps(INFINITY), t, valid);
+		__m256 closest = _mm256_min_ps(masked, _mm256_permute2f128_ps(masked, masked, 1));
+		closest = _mm256_min_ps(closest, _mm256_shuffle_ps(closest, closest, _MM_SHUFFLE(2, 3, 0, 1)));
+		closest = _mm256_min_ps(closest, _mm256_shuffle_ps(closest, closest, _MM_SHUFFLE(1, 0, 3, 2)));
+		int lane = SIMD_LOWEST_LANE(_mm256_movemask_ps(_mm256_cmp_ps(masked, closest, _CMP_EQ_OQ)) & mask);
+		*tMax = _mm256_cvtss_f32(closest);
+		best = first + base + lane;
+	}
+	return best;
+}
+
+SIMD_TARGET("avx2")
+static bool OccludedAVX2(const TrianglePack *pack, int first, int count, Line *ray, float tMin, float tMax){
+	if(count <= 4) return OccludedSSE41(pack, first, count, ray, tMin, tMax);
+	__m256 o[3] = {_mm256_set1_ps(ray->origin.x), _mm256_set1_ps(ray->origin.y), _mm256_set1_ps(ray->origin.z)};
+	__m256 d[3] = {_mm256_set1_ps(ray->direction.x), _mm256_set1_ps(ray->direction.y), _mm256_set1_ps(ray->direction.z)};
+	for(int base = 0; base < count; base += 8){
+		__m256 t;
+		__m256 valid = _mm256_and_ps(Test8(pack, first + base, o, d, &t), Lanes8(count - base));
+		__m256 inRange = _mm256_and_ps(_mm256_cmp_ps(t, _mm256_set1_ps(tMin), _CMP_GT_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(tMax), _CMP_LT_OQ));
+		if(_mm256_movemask_ps(_mm256_and_ps(valid, inRange)) != 0) return true;
+	}
+	return false;
+}
+
+#endif
+
+
+// ───── Dispatch ─────
+
+typedef int (*IntersectKernel)(const TrianglePack *pack, int first, int count, Line *ray, float *tMax);
+typedef bool (*OccludedKernel)(const TrianglePack *pack, int first, int count, Line *ray, float tMin, float tMax);
+
+static const IntersectKernel intersectKernels[SIMD_NUM_LEVELS] = {
+#if SIMD_X86
+	IntersectScalar, IntersectSSE41, IntersectAVX2
+#else
+	IntersectScalar, IntersectScalar, IntersectScalar
+#endif
+};
+
+static const OccludedKernel occludedKernels[SIMD_NUM_LEVELS] = {
+#if SIMD_X86
+	OccludedScalar, OccludedSSE41, OccludedAVX2
+#else
+	OccludedScalar, OccludedScalar, OccludedScalar
+#endif
+};
+
+int TrianglePack_intersect(const TrianglePack *pack, int first, int count, Line *ray, float *tMax){
+	return intersectKernels[simdLevel](pack, first, count, ray, tMax);
+}
+
+bool TrianglePack_occluded(const TrianglePack *pack, int first, int count, Line *ray, float tMin, float tMax){
+	return occludedKernels[simdLevel](pack, first, count, ray, tMin, tMax);
+}
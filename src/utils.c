@@ -2,10 +2,20 @@
 #define PROJECT_DIR "."
 #endif
 
+// clock_gettime and strdup are POSIX, not ISO C
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include"utils.h"
 #include<stdio.h>
 #include<string.h>
 #include<stdlib.h>
+#include<time.h>
+
+#ifdef _WIN32
+#include<windows.h>
+#endif
 
 char* GetFullPath(char *fileName){
 	int length = strlen(PROJECT_DIR) + strlen(fileName) + 2;
@@ -41,4 +51,19 @@ char *GetDirectoryPath(char *fullPath){
 	}
 	directoryPath[last + 1] = '\0';
 	return directoryPath;
-}
\ No newline at end of file
+}
+
+double GetTimeMs(){
+	// a monotonic clock, the wall clock jumps when it is adjusted and would skew the measured durations
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	if(frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart * 1000.0 / frequency.QuadPart;
+#else
+	struct timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return time.tv_sec * 1000.0 + time.tv_nsec / 1e6;
+#endif
+}
@@ -0,0 +1,77 @@
+/**
+ * Checks that rendering does no heap allocation once the first frame has been rendered.
+ *
+ * The test is linked with --wrap=malloc, --wrap=calloc and --wrap=realloc, so every allocation of the project,
+ * from any thread, goes through the counters below. A warm-up frame of every configuration sizes the buffers
+ * of the renderer, then the same frames are rendered again and must not allocate anything.
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdatomic.h>
+#include"project.h"
+
+#define TEST_WIDTH 160
+#define TEST_HEIGHT 90
+#define TEST_WORKERS 2
+#define TEST_FRAMES 3
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+
+static atomic_int allocations;
+
+void *__wrap_malloc(size_t size){
+	atomic_fetch_add(&allocations, 1);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size){
+	atomic_fetch_add(&allocations, 1);
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *pointer, size_t size){
+	atomic_fetch_add(&allocations, 1);
+	return __real_realloc(pointer, size);
+}
+
+/**
+ * Renders the frames of a configuration after a warm-up frame.
+ *
+ * @return Number of allocations of the frames after the warm-up, -1 if a frame fails.
+ */
+static int CountAllocations(Renderer *renderer, Scene *scene, uint32_t *pixels, int antiAliasingFactor){
+	if(Renderer_render(renderer, scene, pixels, TEST_WIDTH, TEST_HEIGHT, TEST_WIDTH, antiAliasingFactor) != 0) return -1;
+	atomic_store(&allocations, 0);
+	for(int i = 0; i < TEST_FRAMES; i++){
+		if(Renderer_render(renderer, scene, pixels, TEST_WIDTH, TEST_HEIGHT, TEST_WIDTH, antiAliasingFactor) != 0) return -1;
+	}
+	return atomic_load(&allocations);
+}
+
+int main(){
+	Scene *scene = CreateScene(0, NULL);
+	ThreadPool *pool = ThreadPool_new(TEST_WORKERS);
+	Renderer *renderer = pool != NULL ? Renderer_new(pool) : NULL;
+	uint32_t *pixels = malloc(TEST_WIDTH * TEST_HEIGHT * sizeof(uint32_t));
+	if(scene == NULL || renderer == NULL || pixels == NULL){
+		printf("ERROR::TEST::main::Failed to create the scene or the renderer\n");
+		return 1;
+	}
+
+	int failures = 0;
+	for(int antiAliasingFactor = 1; antiAliasingFactor <= 2; antiAliasingFactor++){
+		for(int packets = 0; packets <= 1; packets++){
+			renderer->packets = packets;
+			int count = CountAllocations(renderer, scene, pixels, antiAliasingFactor);
+			printf("AA %d, %s: %d allocations in %d frames\n", antiAliasingFactor, packets ? "packets" : "single rays", count, TEST_FRAMES);
+			if(count != 0) failures++;
+		}
+	}
+
+	Renderer_free(renderer);
+	ThreadPool_free(pool);
+	free(pixels);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,333 @@
+/**
+ * Checks that every SIMD level supported by the CPU reports the same hits as the scalar code.
+ *
+ * Random rays are tested against random ranges of a TrianglePack holding regular, tiny and degenerate triangles
+ * (collinear or duplicated vertices), with rays lying in the plane of a triangle and ranges ending inside a group
+ * of lanes or on the padding at the end of the pack. Every level is forced with Simd_setLevel, and the index and
+ * distance of the closest hit and the occlusion result must be exactly those of Triangle_intersect.
+ *
+ * A SpherePool mixing spheres, lights and meshes is tested the same way against Sphere_intersection and
+ * Sphere_occluded, the mesh positions and the padding must never hit through their -INFINITY squared radius.
+ *
+ * Finally the camera rays of the demo scene are traced by packets, with random sets of active rays, and every
+ * ray must get the hit Scene_intersection gives it alone.
+ */
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<math.h>
+#include"project.h"
+
+#define TEST_SEED 2024
+#define TEST_RAYS 20000
+/** Not a multiple of the lane count, so that the last group of lanes reads the padding. */
+#define TEST_TRIANGLES 45
+#define TEST_MODELS 29
+/** Side of the image whose camera rays are traced by packets. */
+#define TEST_IMAGE 96
+/** Mismatches printed per level, the others are only counted. */
+#define TEST_MAX_REPORTS 5
+
+static float RandomRange(Sampler *sampler, float min, float max){
+	return min + (max - min) * Sampler_next1D(sampler);
+}
+
+static Point RandomPoint(Sampler *sampler, float extent){
+	return Point_new(RandomRange(sampler, -extent, extent), RandomRange(sampler, -extent, extent), RandomRange(sampler, -extent, extent));
+}
+
+static int RandomInt(Sampler *sampler, int count){
+	return (int)(Sampler_nextUInt(sampler) % (uint32_t)count);
+}
+
+/**
+ * Point of a triangle from barycentric coordinates, slightly outside the triangle when they are.
+ */
+static Point TrianglePoint(const Triangle *t, float u, float v){
+	Vector e1 = Vector_fromPoints(&t->a, &t->b);
+	Vector e2 = Vector_fromPoints(&t->a, &t->c);
+	return Point_translate(&t->a, Vector_sum(Vector_scale(e1, u), Vector_scale(e2, v)));
+}
+
+/**
+ * Fills the triangles, one kind after the other: regular, tiny (determinant around the epsilon of
+ * Triangle_intersect), collinear vertices, two equal vertices and three equal vertices.
+ */
+static void CreateTriangles(Sampler *sampler, Triangle *triangles, int count){
+	for(int i = 0; i < count; i++){
+		Point a = RandomPoint(sampler, 1);
+		Point b = RandomPoint(sampler, 1);
+		Point c = RandomPoint(sampler, 1);
+		switch(i % 5){
+			case 1:
+				b = Point_translate(&a, Vector_scale(Vector_fromPoints(&a, &b), 0.004f));
+				c = Point_translate(&a, Vector_scale(Vector_fromPoints(&a, &c), 0.004f));
+				break;
+			case 2:
+				c = Point_translate(&a, Vector_scale(Vector_fromPoints(&a, &b), RandomRange(sampler, -1, 2)));
+				break;
+			case 3:
+				c = b;
+				break;
+			case 4:
+				b = a;
+				c = a;
+				break;
+		}
+		triangles[i] = Triangle_new(a, b, c, 0);
+	}
+}
+
+/**
+ * Creates a ray of one of the kinds: aimed around a point of a triangle, lying in the plane of a triangle,
+ * starting on a vertex, or random.
+ */
+static Line CreateRay(Sampler *sampler, const Triangle *triangles, int count){
+	const Triangle *t = &triangles[RandomInt(sampler, count)];
+	Point origin = RandomPoint(sampler, 2);
+	Vector direction;
+	switch(RandomInt(sampler, 4)){
+		case 0:{
+			Point target = TrianglePoint(t, RandomRange(sampler, -0.1f, 1.1f), RandomRange(sampler, -0.1f, 1.1f));
+			direction = Vector_fromPoints(&origin, &target);
+			break;
+		}
+		case 1:
+			origin = TrianglePoint(t, RandomRange(sampler, -1, 1), RandomRange(sampler, -1, 1));
+			direction = Vector_sum(Vector_scale(Vector_fromPoints(&t->a, &t->b), RandomRange(sampler, -1, 1)),
+			                       Vector_scale(Vector_fromPoints(&t->a, &t->c), RandomRange(sampler, -1, 1)));
+			break;
+		case 2:
+			origin = t->a;
+			direction = Vector_fromPoints(&origin, &(Point){0, 0, 0});
+			break;
+		default:
+			direction = Vector_fromPoints(&origin, &(Point){RandomRange(sampler, -1, 1), RandomRange(sampler, -1, 1), RandomRange(sampler, -1, 1)});
+	}
+	if(direction.x == 0 && direction.y == 0 && direction.z == 0) direction = Vector_init(0, 0, 1);
+	return Line_init(origin, Vector_normalize(direction));
+}
+
+/**
+ * Picks a range of a structure of count positions, ending on the last position one time out of four.
+ */
+static void RandomRangeOf(Sampler *sampler, int count, int *first, int *rangeCount){
+	*first = RandomInt(sampler, count);
+	*rangeCount = RandomInt(sampler, 4) == 0 ? count - *first : 1 + RandomInt(sampler, count - *first);
+}
+
+/**
+ * Distance of the closest hit found so far: none, or a random one cutting some of the hits.
+ */
+static float RandomMaxDistance(Sampler *sampler){
+	return RandomInt(sampler, 2) == 0 ? INFINITY : RandomRange(sampler, 0, 4);
+}
+
+/**
+ * Tests random rays against a TrianglePack at the current level.
+ *
+ * @return Number of mismatches with Triangle_intersect.
+ */
+static int TestTriangles(const Triangle *triangles, const TrianglePack *pack, int count){
+	Sampler sampler;
+	Sampler_init(&sampler, 0, 0, TEST_SEED);
+	int mismatches = 0;
+	for(int r = 0; r < TEST_RAYS; r++){
+		Line ray = CreateRay(&sampler, triangles, count);
+		int first, rangeCount;
+		RandomRangeOf(&sampler, count, &first, &rangeCount);
+		float tMax = RandomMaxDistance(&sampler);
+		float tMin = RandomInt(&sampler, 2) == 0 ? 0 : RandomRange(&sampler, 0, 1);
+
+		int expected = -1;
+		float expectedDistance = tMax;
+		bool expectedOccluded = false;
+		for(int i = first; i < first + rangeCount; i++){
+			float t;
+			if(!Triangle_intersect(&triangles[i], &ray, &t)) continue;
+			if(t < expectedDistance){
+				expectedDistance = t;
+				expected = i;
+			}
+			if(t > tMin && t < tMax) expectedOccluded = true;
+		}
+
+		float distance = tMax;
+		int index = TrianglePack_intersect(pack, first, rangeCount, &ray, &distance);
+		bool occluded = TrianglePack_occluded(pack, first, rangeCount, &ray, tMin, tMax);
+		if(index != expected || distance != expectedDistance || occluded != expectedOccluded){
+			if(mismatches < TEST_MAX_REPORTS){
+				printf("  ray %d, range [%d, %d): triangle %d at %.9g occluded %d, expected triangle %d at %.9g occluded %d\n",
+				       r, first, first + rangeCount, index, distance, occluded, expected, expectedDistance, expectedOccluded);
+			}
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+/**
+ * Fills the models, mostly spheres (some smaller than the 0.1 radius Sphere_intersection clamps to),
+ * with lights and meshes in between.
+ */
+static void CreateModels(Sampler *sampler, Model **models, int count){
+	Material material = Material_new(COLOR_WHITE, 0.1f, COLOR_WHITE, 10, 0);
+	for(int i = 0; i < count; i++){
+		// models keep the center they are given
+		Point *center = Point_init(RandomRange(sampler, -2, 2), RandomRange(sampler, -2, 2), RandomRange(sampler, -2, 2));
+		switch(i % 4){
+			case 0:
+				models[i] = Model_createBox(center, RandomRange(sampler, 0.2f, 1), RandomRange(sampler, 0.2f, 1), RandomRange(sampler, 0.2f, 1), material);
+				break;
+			case 1:
+				models[i] = Model_createSphere(center, RandomRange(sampler, 0.01f, 0.15f), material);
+				break;
+			case 2:
+				models[i] = Model_createSphere(center, RandomRange(sampler, 0.1f, 1), material);
+				models[i]->type = LIGHT;
+				break;
+			default:
+				models[i] = Model_createSphere(center, RandomRange(sampler, 0.1f, 1), material);
+		}
+	}
+}
+
+/**
+ * Tests random rays against a SpherePool at the current level, aimed around a model or starting inside a sphere.
+ *
+ * @return Number of mismatches with Sphere_intersection and Sphere_occluded.
+ */
+static int TestSpheres(Model **models, const SpherePool *pool, int count){
+	Sampler sampler;
+	Sampler_init(&sampler, 1, 0, TEST_SEED);
+	int mismatches = 0;
+	for(int r = 0; r < TEST_RAYS; r++){
+		Model *target = models[RandomInt(&sampler, count)];
+		Point origin = RandomInt(&sampler, 4) == 0 ? Point_translate(target->center, Vector_init(RandomRange(&sampler, -0.1f, 0.1f), 0, 0)) : RandomPoint(&sampler, 3);
+		Point aim = Point_translate(target->center, Vector_init(RandomRange(&sampler, -1, 1), RandomRange(&sampler, -1, 1), RandomRange(&sampler, -1, 1)));
+		Vector direction = Vector_fromPoints(&origin, &aim);
+		if(direction.x == 0 && direction.y == 0 && direction.z == 0) direction = Vector_init(0, 0, 1);
+		Line ray = Line_init(origin, Vector_normalize(direction));
+		int first, rangeCount;
+		RandomRangeOf(&sampler, count, &first, &rangeCount);
+		float tMax = RandomMaxDistance(&sampler);
+		float tMin = RandomInt(&sampler, 2) == 0 ? 0 : RandomRange(&sampler, 0, 1);
+		Model *ignore = RandomInt(&sampler, 2) == 0 ? NULL : models[first + RandomInt(&sampler, rangeCount)];
+
+		int expected = -1;
+		float expectedDistance = tMax;
+		bool expectedOccluded = false;
+		for(int i = first; i < first + rangeCount; i++){
+			if(models[i]->type != SPHERE && models[i]->type != LIGHT) continue;
+			Hit hit = Sphere_intersection(models[i], &ray, expectedDistance);
+			if(hit.model != NULL){
+				expectedDistance = hit.distance;
+				expected = i;
+			}
+			if(models[i] != ignore && Sphere_occluded(models[i], &ray, tMin, tMax)) expectedOccluded = true;
+		}
+
+		float distance = tMax;
+		int index = SpherePool_intersect(pool, first, rangeCount, &ray, &distance);
+		bool occluded = SpherePool_occluded(pool, first, rangeCount, &ray, tMin, tMax, ignore);
+		if(index != expected || distance != expectedDistance || occluded != expectedOccluded){
+			if(mismatches < TEST_MAX_REPORTS){
+				printf("  ray %d, range [%d, %d): sphere %d at %.9g occluded %d, expected sphere %d at %.9g occluded %d\n",
+				       r, first, first + rangeCount, index, distance, occluded, expected, expectedDistance, expectedOccluded);
+			}
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+/**
+ * Direction of the camera ray through a point of the image, x and y in pixels.
+ */
+static Vector CameraDirection(const Camera *camera, float x, float y){
+	float viewport = 2 * tan(camera->fov / 2);
+	Vector direction = Vector_sum(camera->front, Vector_scale(camera->right, (x / TEST_IMAGE - 0.5) * viewport));
+	return Vector_sum(direction, Vector_scale(camera->up, (0.5 - y / TEST_IMAGE) * viewport));
+}
+
+/**
+ * Traces the camera rays of the scene by packets of 4x2 pixels at the current level, half of the packets
+ * with a random subset of active rays.
+ *
+ * @return Number of rays whose hit differs from Scene_intersection.
+ */
+static int TestPackets(Scene *scene){
+	Sampler sampler;
+	Sampler_init(&sampler, 2, 0, TEST_SEED);
+	Camera *camera = scene->camera;
+	int mismatches = 0;
+	for(int top = 0; top < TEST_IMAGE; top += PACKET_HEIGHT){
+		for(int left = 0; left < TEST_IMAGE; left += PACKET_WIDTH){
+			Vector directions[PACKET_SIZE];
+			for(int i = 0; i < PACKET_SIZE; i++){
+				directions[i] = CameraDirection(camera, left + i % PACKET_WIDTH + 0.5f, top + i / PACKET_WIDTH + 0.5f);
+			}
+			Vector corners[4] = {CameraDirection(camera, left, top), CameraDirection(camera, left + PACKET_WIDTH, top),
+				CameraDirection(camera, left + PACKET_WIDTH, top + PACKET_HEIGHT), CameraDirection(camera, left, top + PACKET_HEIGHT)};
+			RayPacket packet;
+			RayPacket_init(&packet, *camera->position, directions, corners);
+			uint32_t all = (1u << PACKET_SIZE) - 1;
+			uint32_t active = RandomInt(&sampler, 2) == 0 ? all : Sampler_nextUInt(&sampler) & all;
+
+			Hit hits[PACKET_SIZE];
+			Scene_intersectPacket(scene, &packet, active, hits);
+			for(int i = 0; i < PACKET_SIZE; i++){
+				if(!(active & (1u << i))) continue;
+				Hit expected = Scene_intersection(scene, &packet.rays[i], INFINITY);
+				bool same = hits[i].model == expected.model;
+				if(same && expected.model != NULL) same = hits[i].distance == expected.distance;
+				if(!same){
+					if(mismatches < TEST_MAX_REPORTS){
+						printf("  pixel (%d, %d): model %p at %.9g, expected model %p at %.9g\n", left + i % PACKET_WIDTH, top + i / PACKET_WIDTH,
+						       (void*)hits[i].model, hits[i].distance, (void*)expected.model, expected.distance);
+					}
+					mismatches++;
+				}
+			}
+		}
+	}
+	return mismatches;
+}
+
+int main(){
+	Sampler sampler;
+	Sampler_init(&sampler, 0, 0, TEST_SEED);
+	Triangle triangles[TEST_TRIANGLES];
+	CreateTriangles(&sampler, triangles, TEST_TRIANGLES);
+	TrianglePack *pack = TrianglePack_new(TEST_TRIANGLES);
+	if(pack == NULL) return 1;
+	for(int i = 0; i < TEST_TRIANGLES; i++) TrianglePack_set(pack, i, &triangles[i]);
+
+	Model *models[TEST_MODELS];
+	CreateModels(&sampler, models, TEST_MODELS);
+	SpherePool *pool = SpherePool_new(TEST_MODELS);
+	if(pool == NULL) return 1;
+	for(int i = 0; i < TEST_MODELS; i++) SpherePool_set(pool, i, models[i]);
+
+	Scene *scene = CreateScene(0, NULL);
+	if(scene == NULL) return 1;
+
+	int failures = 0;
+	for(SimdLevel level = SIMD_SCALAR; level < SIMD_NUM_LEVELS; level++){
+		if(!Simd_supported(level)){
+			printf("%s: not supported, skipped\n", Simd_levelName(level));
+			continue;
+		}
+		Simd_setLevel(level);
+		int triangleMismatches = TestTriangles(triangles, pack, TEST_TRIANGLES);
+		int sphereMismatches = TestSpheres(models, pool, TEST_MODELS);
+		int packetMismatches = TestPackets(scene);
+		printf("%s: %d triangle and %d sphere mismatches in %d rays each, %d packet mismatches in %d camera rays\n", Simd_levelName(level),
+		       triangleMismatches, sphereMismatches, TEST_RAYS, packetMismatches, TEST_IMAGE * TEST_IMAGE);
+		if(triangleMismatches != 0 || sphereMismatches != 0 || packetMismatches != 0) failures++;
+	}
+
+	TrianglePack_free(pack);
+	SpherePool_free(pool);
+	return failures == 0 ? 0 : 1;
+}